@@ -27,7 +27,8 @@ public class FPSCore : ModuleRules
 				"Core",
                 "PhysicsCore",
                 "Niagara",
-                "EnhancedInput"
+                "EnhancedInput",
+                "AIModule"
                 // ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -41,11 +42,17 @@ public class FPSCore : ModuleRules
 				"Slate",
 				"SlateCore",
 				"Niagara",
+				"SignificanceManager",
+				"ReplicationGraph",
+				"NetCore",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
 		
 		
+		// Compatible with both the generic replication system and Iris
+		SetupIrisSupport(Target);
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
@@ -49,6 +49,12 @@ void AAmmoPickup::Interact()
 {
 	if (!bIsEmpty)
 	{
+		// Waking the pickup up, so that its new state is sent to every connection
+		if (HasAuthority())
+		{
+			FlushNetDormancy();
+		}
+
 		const AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
 		AFPSCharacterController *CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
 
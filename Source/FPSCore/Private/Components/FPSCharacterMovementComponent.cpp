@@ -0,0 +1,443 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Components/FPSCharacterMovementComponent.h"
+#include "FPSCharacter.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/RootMotionSource.h"
+
+namespace FPSMovement
+{
+	/** The requested movement state is packed into the three lowest custom compressed flags */
+	constexpr uint8 MovementStateShift = 4;
+	constexpr uint8 MovementStateMask = FSavedMove_Character::FLAG_Custom_0 | FSavedMove_Character::FLAG_Custom_1 | FSavedMove_Character::FLAG_Custom_2;
+
+	uint8 PackMovementState(const EMovementState MovementState)
+	{
+		return (static_cast<uint8>(MovementState) << MovementStateShift) & MovementStateMask;
+	}
+
+	EMovementState UnpackMovementState(const uint8 Flags)
+	{
+		// Values outside of the enum can only come from a malformed move, and are treated as idle
+		const uint8 Value = (Flags & MovementStateMask) >> MovementStateShift;
+		return Value <= static_cast<uint8>(EMovementState::State_Vault) ? static_cast<EMovementState>(Value) : EMovementState::State_Idle;
+	}
+}
+
+/** A saved move which also remembers the movement state it was performed with */
+class FSavedMove_FPSCharacter : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override
+	{
+		Super::Clear();
+		RequestedMovementState = EMovementState::State_Idle;
+		VaultTargetLocation = FVector::ZeroVector;
+		bHasVaultTarget = false;
+	}
+
+	virtual uint8 GetCompressedFlags() const override
+	{
+		return Super::GetCompressedFlags() | FPSMovement::PackMovementState(RequestedMovementState);
+	}
+
+	virtual bool CanCombineWith(const FSavedMovePtr &NewMove, ACharacter *InCharacter, float MaxDelta) const override
+	{
+		const FSavedMove_FPSCharacter *NewFPSMove = static_cast<const FSavedMove_FPSCharacter *>(NewMove.Get());
+		if (RequestedMovementState != NewFPSMove->RequestedMovementState || bHasVaultTarget || NewFPSMove->bHasVaultTarget)
+		{
+			return false;
+		}
+		return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+	}
+
+	virtual void SetMoveFor(ACharacter *Character, float InDeltaTime, FVector const &NewAccel, FNetworkPredictionData_Client_Character &ClientData) override
+	{
+		Super::SetMoveFor(Character, InDeltaTime, NewAccel, ClientData);
+
+		if (const UFPSCharacterMovementComponent *MovementComponent = Cast<UFPSCharacterMovementComponent>(Character->GetCharacterMovement()))
+		{
+			RequestedMovementState = MovementComponent->RequestedMovementState;
+			VaultTargetLocation = MovementComponent->VaultTargetLocation;
+			bHasVaultTarget = MovementComponent->bHasVaultTarget;
+		}
+	}
+
+	virtual void PrepMoveFor(ACharacter *Character) override
+	{
+		Super::PrepMoveFor(Character);
+
+		// Replaying the move with the state it was originally performed with
+		if (UFPSCharacterMovementComponent *MovementComponent = Cast<UFPSCharacterMovementComponent>(Character->GetCharacterMovement()))
+		{
+			MovementComponent->RequestedMovementState = RequestedMovementState;
+			MovementComponent->VaultTargetLocation = VaultTargetLocation;
+			MovementComponent->bHasVaultTarget = bHasVaultTarget;
+		}
+	}
+
+	/** The movement state requested when the move was performed */
+	EMovementState RequestedMovementState = EMovementState::State_Idle;
+
+	/** The vault target that had not been used yet when the move was performed, so that replaying the move starts the
+	 *	vault again */
+	FVector VaultTargetLocation = FVector::ZeroVector;
+	bool bHasVaultTarget = false;
+};
+
+/** Client prediction data allocating FSavedMove_FPSCharacter moves */
+class FNetworkPredictionData_Client_FPSCharacter : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	explicit FNetworkPredictionData_Client_FPSCharacter(const UCharacterMovementComponent &ClientMovement)
+		: Super(ClientMovement)
+	{
+	}
+
+	virtual FSavedMovePtr AllocateNewMove() override
+	{
+		return FSavedMovePtr(new FSavedMove_FPSCharacter());
+	}
+};
+
+const FName UFPSCharacterMovementComponent::VaultRootMotionName(TEXT("FPSCoreVault"));
+
+void UFPSCharacterMovementComponent::SetRequestedMovementState(const EMovementState NewMovementState)
+{
+	// Vaults run to the end once requested, after which the character requests its next state (see
+	// AFPSCharacter::OnVaultFinished)
+	const bool bVaultRequested = RequestedMovementState == EMovementState::State_Vault && (bHasVaultTarget || IsVaulting());
+	if (bVaultRequested && NewMovementState != EMovementState::State_Vault)
+	{
+		return;
+	}
+	RequestedMovementState = NewMovementState;
+}
+
+void UFPSCharacterMovementComponent::SetVaultTarget(const FVector &TargetLocation)
+{
+	VaultTargetLocation = TargetLocation;
+	bHasVaultTarget = true;
+}
+
+bool UFPSCharacterMovementComponent::IsVaulting() const
+{
+	// Removed root motion is only marked for removal until the end of the move
+	const TSharedPtr<FRootMotionSource> VaultMotion = CurrentRootMotion.GetRootMotionSource(VaultRootMotionName);
+	return VaultMotion.IsValid() && !VaultMotion->Status.HasFlag(ERootMotionSourceStatusFlags::Finished) && !VaultMotion->Status.HasFlag(ERootMotionSourceStatusFlags::MarkedForRemoval);
+}
+
+bool UFPSCharacterMovementComponent::HasVaultEnded() const
+{
+	// Vaults fly the character along their root motion, which may already have been removed once it has finished
+	if (MovementMode != MOVE_Flying || IsVaulting())
+	{
+		return false;
+	}
+	return CurrentRootMotion.GetRootMotionSource(VaultRootMotionName).IsValid() || (FPSCharacterOwner && FPSCharacterOwner->GetMovementState() == EMovementState::State_Vault);
+}
+
+void UFPSCharacterMovementComponent::SetUpdatedComponent(USceneComponent *NewUpdatedComponent)
+{
+	Super::SetUpdatedComponent(NewUpdatedComponent);
+
+	FPSCharacterOwner = Cast<AFPSCharacter>(CharacterOwner);
+}
+
+FNetworkPredictionData_Client *UFPSCharacterMovementComponent::GetPredictionData_Client() const
+{
+	check(PawnOwner != nullptr);
+
+	if (!ClientPredictionData)
+	{
+		UFPSCharacterMovementComponent *MutableThis = const_cast<UFPSCharacterMovementComponent *>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_FPSCharacter(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+void UFPSCharacterMovementComponent::UpdateFromCompressedFlags(const uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	RequestedMovementState = FPSMovement::UnpackMovementState(Flags);
+}
+
+bool UFPSCharacterMovementComponent::ClientUpdatePositionAfterServerUpdate()
+{
+	// Replaying saved moves restores the state of each move, so the state requested since then is put back afterwards
+	const EMovementState RealRequestedMovementState = RequestedMovementState;
+	const FVector RealVaultTargetLocation = VaultTargetLocation;
+	const bool bRealHasVaultTarget = bHasVaultTarget;
+
+	ReplayedMovementState = FPSCharacterOwner ? FPSCharacterOwner->GetMovementState() : RequestedMovementState;
+	bVaultFinishedDuringReplay = false;
+
+	const bool bResult = Super::ClientUpdatePositionAfterServerUpdate();
+
+	RequestedMovementState = RealRequestedMovementState;
+	VaultTargetLocation = RealVaultTargetLocation;
+	bHasVaultTarget = bRealHasVaultTarget;
+
+	// Replayed moves only apply movement values, so the weapon restrictions, timers and animations of the state that
+	// the replay ended in are applied once, now, rather than for every replayed move
+	if (FPSCharacterOwner)
+	{
+		if (FPSCharacterOwner->GetMovementState() != ReplayedMovementState && !(bVaultFinishedDuringReplay && ReplayedMovementState == EMovementState::State_Vault))
+		{
+			FPSCharacterOwner->SetMovementState(ReplayedMovementState);
+		}
+		if (bVaultFinishedDuringReplay)
+		{
+			FPSCharacterOwner->OnVaultFinished();
+		}
+	}
+	return bResult;
+}
+
+void UFPSCharacterMovementComponent::UpdateCharacterStateBeforeMovement(const float DeltaSeconds)
+{
+	// Simulated proxies take their crouch and movement mode from replication instead
+	const bool bSimulatedProxy = CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy;
+
+	// Crouching and sliding share the crouched capsule, which the engine resizes before the move is performed
+	if (!bSimulatedProxy)
+	{
+		bWantsToCrouch = !IsVaulting() && (RequestedMovementState == EMovementState::State_Crouch || RequestedMovementState == EMovementState::State_Slide);
+	}
+
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	if (!bSimulatedProxy)
+	{
+		// Vaults start with the first move requesting them once the target is known, and end with their root motion,
+		// whichever state the move requests. The server may receive the request before the target if the target had to
+		// be resent, and corrects the client once it starts
+		if (RequestedMovementState == EMovementState::State_Vault && bHasVaultTarget && !IsVaulting())
+		{
+			StartVault();
+		}
+		else if (HasVaultEnded())
+		{
+			StopVault();
+		}
+
+		// The vault state is kept for as long as the vault moves the character. Requests for a vault which has not started,
+		// as the server refused or has not received its target, keep the state from before the vault
+		EMovementState MovementStateToApply = RequestedMovementState;
+		if (IsVaulting())
+		{
+			MovementStateToApply = EMovementState::State_Vault;
+		}
+		else if (MovementStateToApply == EMovementState::State_Vault)
+		{
+			MovementStateToApply = LastNonVaultMovementState;
+		}
+		else
+		{
+			LastNonVaultMovementState = MovementStateToApply;
+		}
+
+		// Slides start from the ground, and end as soon as they are no longer requested
+		if (MovementStateToApply == EMovementState::State_Slide && MovementMode == MOVE_Walking)
+		{
+			SetMovementMode(MOVE_Custom, CMOVE_Slide);
+		}
+		else if (MovementStateToApply != EMovementState::State_Slide && IsSliding())
+		{
+			SetMovementMode(MOVE_Walking);
+		}
+
+		ApplyMovementState(MovementStateToApply);
+	}
+}
+
+void UFPSCharacterMovementComponent::ApplyMovementState(const EMovementState NewMovementState)
+{
+	if (!FPSCharacterOwner)
+	{
+		return;
+	}
+
+	// Applied every move rather than on change, so that RuntimeUpdateMovementValues takes effect straight away
+	if (const FMovementVariables *MovementData = FPSCharacterOwner->GetMovementData(NewMovementState))
+	{
+		MaxAcceleration = MovementData->MaxAcceleration;
+		BrakingDecelerationWalking = MovementData->BreakingDecelerationWalking;
+		GroundFriction = MovementData->GroundFriction;
+		MaxWalkSpeed = MovementData->MaxWalkSpeed;
+	}
+
+	// Replayed moves leave the state to ClientUpdatePositionAfterServerUpdate
+	if (bClientUpdating)
+	{
+		ReplayedMovementState = NewMovementState;
+		return;
+	}
+
+	if (FPSCharacterOwner->GetMovementState() != NewMovementState)
+	{
+		FPSCharacterOwner->SetMovementState(NewMovementState);
+	}
+}
+
+void UFPSCharacterMovementComponent::StartVault()
+{
+	bHasVaultTarget = false;
+
+	if (!FPSCharacterOwner)
+	{
+		return;
+	}
+
+	// Vaults without any motion are over as soon as they have started
+	const float Duration = FPSCharacterOwner->GetVaultDuration();
+	if (Duration <= 0.0f)
+	{
+		FinishVault();
+		return;
+	}
+
+	// Moving to the target over the duration of the vault curve, following the curve, with nothing else affecting the
+	// character's velocity on the way
+	const TSharedPtr<FRootMotionSource_MoveToDynamicForce> VaultMotion = MakeShared<FRootMotionSource_MoveToDynamicForce>();
+	VaultMotion->InstanceName = VaultRootMotionName;
+	VaultMotion->AccumulateMode = ERootMotionAccumulateMode::Override;
+	VaultMotion->Priority = 500;
+	VaultMotion->StartLocation = UpdatedComponent->GetComponentLocation();
+	VaultMotion->InitialTargetLocation = VaultTargetLocation;
+	VaultMotion->TargetLocation = VaultTargetLocation;
+	VaultMotion->Duration = Duration;
+	VaultMotion->bRestrictSpeedAtEnd = false;
+	VaultMotion->TimeMappingCurve = FPSCharacterOwner->GetVaultCurve();
+	VaultMotion->FinishVelocityParams.Mode = ERootMotionFinishVelocityMode::SetVelocity;
+	VaultMotion->FinishVelocityParams.SetVelocity = FVector::ZeroVector;
+
+	// Flying, so that neither gravity nor the floor get in the way of the motion
+	SetMovementMode(MOVE_Flying);
+	ApplyRootMotionSource(VaultMotion);
+}
+
+void UFPSCharacterMovementComponent::StopVault()
+{
+	RemoveRootMotionSource(VaultRootMotionName);
+
+	// Falling finds the floor that we have been moved onto straight away, and lands on it
+	SetMovementMode(MOVE_Falling);
+
+	FinishVault();
+}
+
+void UFPSCharacterMovementComponent::CancelVault(const FVector &TargetLocation)
+{
+	// A refusal that arrives after we have moved on to another vault is about a vault that is already over
+	if (FVector::DistSquared(TargetLocation, VaultTargetLocation) > 1.0f)
+	{
+		return;
+	}
+
+	// Forgetting the target in the moves that the server has not acknowledged yet, so that replaying them does not start
+	// the vault again
+	if (FNetworkPredictionData_Client_Character *ClientData = GetPredictionData_Client_Character())
+	{
+		for (const FSavedMovePtr &SavedMove : ClientData->SavedMoves)
+		{
+			static_cast<FSavedMove_FPSCharacter *>(SavedMove.Get())->bHasVaultTarget = false;
+		}
+		if (ClientData->PendingMove.IsValid())
+		{
+			static_cast<FSavedMove_FPSCharacter *>(ClientData->PendingMove.Get())->bHasVaultTarget = false;
+		}
+	}
+
+	bHasVaultTarget = false;
+	if (IsVaulting() || HasVaultEnded())
+	{
+		StopVault();
+	}
+	else
+	{
+		FinishVault();
+	}
+}
+
+void UFPSCharacterMovementComponent::FinishVault()
+{
+	// The requested state is put back once moves have been replayed, so the character hears about the end of the vault
+	// afterwards
+	if (bClientUpdating)
+	{
+		bVaultFinishedDuringReplay = true;
+	}
+	else if (FPSCharacterOwner)
+	{
+		FPSCharacterOwner->OnVaultFinished();
+	}
+}
+
+bool UFPSCharacterMovementComponent::IsMovingOnGround() const
+{
+	return Super::IsMovingOnGround() || IsSliding();
+}
+
+bool UFPSCharacterMovementComponent::CanAttemptJump() const
+{
+	// Crouched and sliding characters may still jump
+	return IsJumpAllowed() && (IsMovingOnGround() || IsFalling());
+}
+
+float UFPSCharacterMovementComponent::GetMaxSpeed() const
+{
+	// Every ground state (crouching included) moves at the MaxWalkSpeed of its movement data
+	if (IsMovingOnGround())
+	{
+		return MaxWalkSpeed;
+	}
+	return Super::GetMaxSpeed();
+}
+
+float UFPSCharacterMovementComponent::GetMaxBrakingDeceleration() const
+{
+	return IsSliding() ? BrakingDecelerationWalking : Super::GetMaxBrakingDeceleration();
+}
+
+void UFPSCharacterMovementComponent::OnMovementModeChanged(const EMovementMode PreviousMovementMode, const uint8 PreviousCustomMode)
+{
+	Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+
+	// Slides are ground movement, so they keep the floor and base that walking does
+	if (IsSliding())
+	{
+		Velocity.Z = 0.0f;
+		bCrouchMaintainsBaseLocation = true;
+		FindFloor(UpdatedComponent->GetComponentLocation(), CurrentFloor, false);
+		AdjustFloorHeight();
+		SetBaseFromFloor(CurrentFloor);
+	}
+}
+
+void UFPSCharacterMovementComponent::PhysCustom(const float DeltaTime, const int32 Iterations)
+{
+	switch (CustomMovementMode)
+	{
+	case CMOVE_Slide:
+		PhysSlide(DeltaTime, Iterations);
+		break;
+
+	default:
+		Super::PhysCustom(DeltaTime, Iterations);
+		break;
+	}
+}
+
+void UFPSCharacterMovementComponent::PhysSlide(const float DeltaTime, const int32 Iterations)
+{
+	// Slides follow the floor exactly like walking does, with the slide's own friction, braking and speed applied by
+	// its movement data. Walking off a ledge drops into falling, and landing resumes the slide if it is still requested
+	PhysWalking(DeltaTime, Iterations);
+}
@@ -4,6 +4,7 @@
 #include "EnhancedInputComponent.h"
 #include "FPSCharacter.h"
 #include "FPSCharacterController.h"
+#include "FPSCore.h"
 #include "WeaponBase.h"
 #include "WeaponPickup.h"
 #include "GameFramework/Actor.h"
@@ -163,8 +164,7 @@ void UInventoryComponent::SwapWeapon(const int SlotId)
 	// Disabling the currently equipped weapon, if it exists
 	if (CurrentWeapon)
 	{
-		CurrentWeapon->PrimaryActorTick.bCanEverTick = false;
-		CurrentWeapon->SetActorHiddenInGame(true);
+		CurrentWeapon->SetHolstered(true);
 		CurrentWeapon->SetCanFire(true);
 		CurrentWeapon->Client_StopFire();
 	}
@@ -173,15 +173,15 @@ void UInventoryComponent::SwapWeapon(const int SlotId)
 	CurrentWeapon = EquippedWeapons[SlotId];
 	if (CurrentWeapon)
 	{
-		CurrentWeapon->PrimaryActorTick.bCanEverTick = true;
-		CurrentWeapon->SetActorHiddenInGame(false);
+		CurrentWeapon->SetHolstered(false);
+		CurrentWeapon->HandleEquip();
 		if (!CurrentWeapon->GetStaticWeaponData()->WeaponUnequip)
 		{
 			if (CurrentWeapon->GetStaticWeaponData()->WeaponEquip)
 			{
 				if (AFPSCharacter *FPSCharacter = Cast<AFPSCharacter>(GetOwner()))
 				{
-					FPSCharacter->UpdateMovementState(FPSCharacter->GetMovementState());
+					FPSCharacter->UpdateWeaponMovementRestrictions();
 					CurrentWeapon->Multi_SwapWeaponAnim();
 				}
 			}
@@ -229,6 +229,13 @@ void UInventoryComponent::SpawnWeapon(TSubclassOf<AWeaponBase> NewWeapon, const
 				NewPickup->SetWeaponReference(EquippedWeapons[InventoryPosition]->GetClass());
 				NewPickup->SetCacheDataStruct(EquippedWeapons[InventoryPosition]->GetRuntimeWeaponData());
 				NewPickup->SpawnAttachmentMesh();
+
+				// Pickups spawned at runtime are not covered by DORM_Initial. Static ones go dormant straight away, while
+				// ones that simulate physics do so once they have come to rest
+				if (bStatic)
+				{
+					NewPickup->SetNetDormancy(DORM_DormantAll);
+				}
 				EquippedWeapons[InventoryPosition]->Destroy();
 			}
 		}
@@ -268,8 +275,7 @@ void UInventoryComponent::UpdateWeapon(AWeaponBase *SpawnedWeapon, const int Inv
 		// Disabling the currently equipped weapon, if it exists
 		if (CurrentWeapon)
 		{
-			CurrentWeapon->PrimaryActorTick.bCanEverTick = false;
-			CurrentWeapon->SetActorHiddenInGame(true);
+			CurrentWeapon->SetHolstered(true);
 			CurrentWeapon->Client_StopFire();
 		}
 
@@ -279,16 +285,22 @@ void UInventoryComponent::UpdateWeapon(AWeaponBase *SpawnedWeapon, const int Inv
 
 		if (CurrentWeapon)
 		{
-			CurrentWeapon->PrimaryActorTick.bCanEverTick = true;
-			CurrentWeapon->SetActorHiddenInGame(false);
+			CurrentWeapon->SetHolstered(false);
+			CurrentWeapon->HandleEquip();
 
 			if (CurrentWeapon->GetStaticWeaponData()->WeaponEquip)
 			{
 				if (CurrentPlayer)
 				{
-					CurrentPlayer->GetHandsMesh()->GetAnimInstance()->StopAllMontages(0.1f);
-					CurrentPlayer->GetHandsMesh()->GetAnimInstance()->Montage_Play(CurrentWeapon->GetStaticWeaponData()->WeaponEquip, 1.0f);
-					CurrentPlayer->UpdateMovementState(CurrentPlayer->GetMovementState());
+					if (FPSCore::ShouldPlayCosmetics(CurrentPlayer))
+					{
+						if (UAnimInstance *HandsAnimInstance = CurrentPlayer->GetHandsMesh()->GetAnimInstance())
+						{
+							HandsAnimInstance->StopAllMontages(0.1f);
+						}
+						FPSCore::PlayMontage(CurrentPlayer->GetHandsMesh(), CurrentWeapon->GetStaticWeaponData()->WeaponEquip);
+					}
+					CurrentPlayer->UpdateWeaponMovementRestrictions();
 				}
 			}
 		}
@@ -324,7 +336,7 @@ void UInventoryComponent::Inspect()
 		{
 			if (CurrentWeapon->GetStaticWeaponData()->HandsInspect)
 			{
-				FPSCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(CurrentWeapon->GetStaticWeaponData()->HandsInspect, 1.0f);
+				FPSCore::PlayMontage(FPSCharacter->GetHandsMesh(), CurrentWeapon->GetStaticWeaponData()->HandsInspect);
 			}
 			if (CurrentWeapon->GetStaticWeaponData()->WeaponInspect)
 			{
@@ -1,6 +1,7 @@
 // Copyright 2022 Ellie Kelemen. All Rights Reserved.
 
 #include "FPSCharacter.h"
+#include "FPSCore.h"
 #include "DrawDebugHelpers.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
@@ -8,13 +9,16 @@
 #include "WeaponBase.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
+#include "Components/FPSCharacterMovementComponent.h"
 #include "Components/InteractionComponent.h"
 #include "Components/InventoryComponent.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Components/TimelineComponent.h"
+#include "Curves/CurveFloat.h"
 #include "Engine/Engine.h"
 #include "TimerManager.h"
 #include "Engine/LocalPlayer.h"
+#include "GameFramework/GameStateBase.h"
 #include "Math/UnrealMathUtility.h"
 // ReSharper disable once CppUnusedIncludeDirective
 #include "EnhancedInputSubsystems.h"
@@ -22,9 +26,28 @@
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/InputSettings.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "Subsystems/LagCompensationSubsystem.h"
+#include "Subsystems/VaultLedgeSubsystem.h"
+#include "VaultLedges.h"
+
+DECLARE_CYCLE_STAT(TEXT("Character Camera Offset"), STAT_CharacterCameraOffset, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Sprint Angle"), STAT_CharacterSprintAngle, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Field Of View"), STAT_CharacterFieldOfView, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Aiming"), STAT_CharacterAiming, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Slide On Landing"), STAT_CharacterSlideOnLanding, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Vault Check"), STAT_CharacterVaultCheck, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Ground Angle"), STAT_CharacterGroundAngle, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Stand Up Check"), STAT_CharacterStandUpCheck, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Character Debug"), STAT_CharacterDebug, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Character Tick Tasks Run"), STAT_CharacterTickTasksRun, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Character Vault Traces"), STAT_CharacterVaultTraces, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Character Stand Up Sweeps"), STAT_CharacterStandUpSweeps, STATGROUP_FPSCore);
 
 // Sets default values
-AFPSCharacter::AFPSCharacter()
+AFPSCharacter::AFPSCharacter(const FObjectInitializer &ObjectInitializer)
+    : Super(ObjectInitializer.SetDefaultSubobjectClass<UFPSCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
     // Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
     PrimaryActorTick.bCanEverTick = true;
@@ -55,6 +78,35 @@ AFPSCharacter::AFPSCharacter()
     ShadowMesh->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::KeepRelativeTransform);
 
     DefaultCapsuleHalfHeight = GetCapsuleComponent()->GetScaledCapsuleHalfHeight(); // setting the default height of the capsule
+
+    // Crouching and sliding use the movement component's predicted crouch
+    GetCharacterMovement()->GetNavAgentPropertiesRef().bCanCrouch = true;
+}
+
+void AFPSCharacter::PostInitializeComponents()
+{
+    Super::PostInitializeComponents();
+
+    // Set here rather than in the constructor so that the value set in blueprints is used, and before any replicated
+    // crouch is applied to simulated proxies
+    GetCharacterMovement()->CrouchedHalfHeight = CrouchedCapsuleHalfHeight;
+}
+
+UFPSCharacterMovementComponent *AFPSCharacter::GetFPSCharacterMovement() const
+{
+    return Cast<UFPSCharacterMovementComponent>(GetCharacterMovement());
+}
+
+void AFPSCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty> &OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    // The owning client predicts its own movement state, so only simulated proxies need it
+    FDoRepLifetimeParams SimulatedOnlyParams;
+    SimulatedOnlyParams.bIsPushBased = true;
+    SimulatedOnlyParams.Condition = COND_SimulatedOnly;
+
+    DOREPLIFETIME_WITH_PARAMS_FAST(AFPSCharacter, MovementState, SimulatedOnlyParams);
 }
 
 // Called when the game starts or when spawned
@@ -79,13 +131,11 @@ void AFPSCharacter::BeginPlay()
 
     DefaultCameraOffset = CameraComponent->GetRelativeLocation().Z; // Setting the default location of the camera
 
-    // Binding a timeline to our vaulting curve
-    if (VaultTimelineCurve)
-    {
-        FOnTimelineFloat TimelineProgress;
-        TimelineProgress.BindUFunction(this, FName("TimelineProgress"));
-        VaultTimeline.AddInterpFloat(VaultTimelineCurve, TimelineProgress);
-    }
+    // The results of our async vault and stand up checks are handed back to us during the frame after we request them
+    VaultWallTraceDelegate.BindUObject(this, &AFPSCharacter::OnVaultWallTraced);
+    StandUpTraceDelegate.BindUObject(this, &AFPSCharacter::OnStandUpTraced);
+
+    RegisterTickTasks();
 
     // Obtaining our inventory component and reserving space in memory for our set of weapons
     if (UInventoryComponent *InventoryComp = FindComponentByClass<UInventoryComponent>())
@@ -105,6 +155,25 @@ void AFPSCharacter::BeginPlay()
             CurrentWeapon->SetTPAttachment();
         }
     }
+
+    // Recording our hitbox history so that the server can rewind us when validating other players' shots
+    if (HasAuthority())
+    {
+        if (ULagCompensationSubsystem *LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+        {
+            LagCompensation->RegisterCharacter(this);
+        }
+    }
+}
+
+void AFPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (ULagCompensationSubsystem *LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+    {
+        LagCompensation->UnregisterCharacter(this);
+    }
+
+    Super::EndPlay(EndPlayReason);
 }
 
 void AFPSCharacter::PawnClientRestart()
@@ -126,6 +195,33 @@ void AFPSCharacter::PawnClientRestart()
     }
 }
 
+void AFPSCharacter::OnStartCrouch(const float HalfHeightAdjust, const float ScaledHalfHeightAdjust)
+{
+    Super::OnStartCrouch(HalfHeightAdjust, ScaledHalfHeightAdjust);
+
+    // The capsule has shrunk around its base, so the camera is raised by the same amount and lowered by Tick from there
+    CurrentCameraOffset += ScaledHalfHeightAdjust;
+    FVector NewCameraLocation = CameraComponent->GetRelativeLocation();
+    NewCameraLocation.Z = CurrentCameraOffset;
+    CameraComponent->SetRelativeLocation(NewCameraLocation);
+}
+
+void AFPSCharacter::OnEndCrouch(const float HalfHeightAdjust, const float ScaledHalfHeightAdjust)
+{
+    Super::OnEndCrouch(HalfHeightAdjust, ScaledHalfHeightAdjust);
+
+    CurrentCameraOffset -= ScaledHalfHeightAdjust;
+    FVector NewCameraLocation = CameraComponent->GetRelativeLocation();
+    NewCameraLocation.Z = CurrentCameraOffset;
+    CameraComponent->SetRelativeLocation(NewCameraLocation);
+}
+
+bool AFPSCharacter::CanJumpInternal_Implementation() const
+{
+    // ACharacter does not allow crouched characters to jump, but crouching was never a reason not to jump here
+    return JumpIsAllowedInternal();
+}
+
 void AFPSCharacter::Move(const FInputActionValue &Value)
 {
     // Storing movement vectors for animation manipulation
@@ -171,7 +267,7 @@ void AFPSCharacter::Look(const FInputActionValue &Value)
         {
             // If movement is detected and we have a current weapon, make sure we don't recover the recoil
             InventoryComponent->GetCurrentWeapon()->SetShouldRecover(false);
-            InventoryComponent->GetCurrentWeapon()->GetRecoilRecoveryTimeline()->Stop();
+            InventoryComponent->GetCurrentWeapon()->StopRecoilRecovery();
         }
     }
 }
@@ -290,8 +386,12 @@ void AFPSCharacter::StartSlide()
 
 void AFPSCharacter::Multi_SlideAnim_Implementation()
 {
-    HandsMeshComp->GetAnimInstance()->Montage_Play(SlideMontage, 1.0f);
-    ThirdPersonMesh->GetAnimInstance()->Montage_Play(SlideMontage, 1.0f);
+    // Dedicated servers only play the third person montage, which moves the hitboxes
+    if (FPSCore::ShouldPlayCosmetics(this))
+    {
+        FPSCore::PlayMontage(HandsMeshComp, SlideMontage);
+    }
+    FPSCore::PlayMontage(ThirdPersonMesh, SlideMontage);
 }
 
 void AFPSCharacter::TimeOutSlide()
@@ -342,207 +442,188 @@ void AFPSCharacter::StopAds()
 
 void AFPSCharacter::CheckVault()
 {
-    if (!bCanVault)
+    // Vaults are decided by the player performing them, the server performs them along with the player's moves
+    if (!bCanVault || !VaultTimelineCurve || !IsLocallyControlled())
         return;
 
     float ForwardVelocity = FVector::DotProduct(GetVelocity(), GetActorForwardVector());
     if (!(ForwardVelocity > 0 && !bIsVaulting && GetCharacterMovement()->IsFalling()))
         return;
 
-    // Store these for future use.
-    FVector ColliderLocation = GetCapsuleComponent()->GetComponentLocation();
-    FRotator ColliderRotation = GetCapsuleComponent()->GetComponentRotation();
-    FVector StartLocation = ColliderLocation;
-    FVector EndLocation = ColliderLocation + UKismetMathLibrary::GetForwardVector(ColliderRotation) * 75;
-    if (bDrawDebug)
-    {
-        DrawDebugCapsule(GetWorld(), StartLocation, 50, 30, FQuat::Identity, FColor::Red);
-    }
-
-    FCollisionQueryParams TraceParams;
-    TraceParams.bTraceComplex = true;
-    TraceParams.AddIgnoredActor(this);
+    const FVector ColliderLocation = GetCapsuleComponent()->GetComponentLocation();
+    const FVector Forward = UKismetMathLibrary::GetForwardVector(GetCapsuleComponent()->GetComponentRotation());
+    const FVaultLedgeSettings Settings = GetVaultLedgeSettings();
 
-    // Checking if we are near a wall
-    if (!GetWorld()->SweepSingleByChannel(MantleHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeCapsule(30, 50), TraceParams))
-        return;
-    if (!MantleHit.bBlockingHit)
+    // Looking up the ledge in front of us if the map's ledges have been baked, and tracing for one where they haven't
+    FVaultLedge Ledge;
+    const UVaultLedgeSubsystem *LedgeSubsystem = GetWorld()->GetSubsystem<UVaultLedgeSubsystem>();
+    const EVaultLedgeLookup Lookup = LedgeSubsystem ? LedgeSubsystem->FindLedge(ColliderLocation, Forward, Settings, Ledge) : EVaultLedgeLookup::Unbaked;
+    if (Lookup == EVaultLedgeLookup::NoLedge)
         return;
 
-    FVector ForwardImpactPoint = MantleHit.ImpactPoint;
-    FVector ForwardImpactNormal = MantleHit.ImpactNormal;
-    FVector CapsuleLocation = ForwardImpactPoint;
-    CapsuleLocation.Z = ColliderLocation.Z;
-    CapsuleLocation += ForwardImpactNormal * -15;
-    StartLocation = CapsuleLocation;
-    StartLocation.Z += 100;
-    EndLocation = CapsuleLocation;
-
-    // Checking if we can stand up on the wall that we've hit
-    if (!GetWorld()->SweepSingleByChannel(MantleHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeSphere(1), TraceParams))
-        return;
-    if (!GetCharacterMovement()->IsWalkable(MantleHit))
-        return;
-
-    FVector SecondaryVaultStartLocation = MantleHit.ImpactPoint;
-    SecondaryVaultStartLocation.Z += 5;
-    FVector SecondaryVaultEndLocation = SecondaryVaultStartLocation;
-    SecondaryVaultEndLocation.Z = 0;
-    FVector SecondaryVaultHeightCheckLocation = SecondaryVaultStartLocation;
-    SecondaryVaultHeightCheckLocation.Z += VaultSpaceHeight;
-
-    if (bDrawDebug)
+    if (Lookup == EVaultLedgeLookup::Found)
     {
-        DrawDebugSphere(GetWorld(), SecondaryVaultStartLocation, 10, 8, FColor::Orange);
+        VaultToLedge(Ledge);
+        return;
     }
 
-    float InitialTraceHeight = 0;
-    float PreviousTraceHeight = 0;
-    float CurrentTraceHeight = 0;
-    bool bInitialSwitch = false;
-    bool bVaultFailed = true;
-
-    int i;
+    // Where no ledges have been baked, we sweep for a wall in front of us with the async trace system, and decide whether
+    // to vault once the result comes back during the next frame. Most of the time there is no wall, and nothing else to trace
+    if (bVaultWallTraceInFlight)
+        return;
 
-    FVector ForwardAddition = UKismetMathLibrary::GetForwardVector(ColliderRotation) * 5;
-    float CalculationHeight = GetCapsuleComponent()->GetScaledCapsuleHalfHeight() + 2;
-    float ScaledCapsuleWithoutHemisphere = GetCapsuleComponent()->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+    INC_DWORD_STAT(STAT_CharacterVaultTraces);
+    VaultTraceLocation = ColliderLocation;
+    VaultTraceForward = Forward;
+    bVaultWallTraceInFlight = true;
+    FPSCore::AsyncTraceVaultWall(GetWorld(), ColliderLocation, Forward, GetVaultQueryParams(), &VaultWallTraceDelegate, bDrawDebug);
+}
 
-    // Tracing downwards VaultTraceAmount times and looking for a significant change in height followed by a space large enough to stand
-    for (i = 0; i <= VaultTraceAmount; i++)
-    {
-        SecondaryVaultStartLocation += ForwardAddition;
-        SecondaryVaultEndLocation += ForwardAddition;
-        SecondaryVaultHeightCheckLocation += ForwardAddition;
-        bVaultFailed = true;
-        if (!GetWorld()->LineTraceSingleByChannel(VaultHit, SecondaryVaultStartLocation, SecondaryVaultEndLocation, ECC_WorldStatic, TraceParams))
-            continue;
-        if (bDrawDebug)
-        {
-            DrawDebugLine(GetWorld(), SecondaryVaultStartLocation, VaultHit.ImpactPoint, FColor::Red, false, 10.0f, 0.0f, 2.0f);
-        }
+void AFPSCharacter::OnVaultWallTraced(const FTraceHandle &TraceHandle, FTraceDatum &TraceData)
+{
+    bVaultWallTraceInFlight = false;
 
-        if (bDrawDebug)
-        {
-            DrawDebugLine(GetWorld(), SecondaryVaultStartLocation, SecondaryVaultHeightCheckLocation, FColor::Green, false, 10.0f, 0.0f, 2.0f);
-        }
-        if (GetWorld()->LineTraceSingleByChannel(VaultHeightHit, SecondaryVaultStartLocation, SecondaryVaultHeightCheckLocation, ECC_WorldStatic, TraceParams))
-            break;
+    // We may have landed, or started vaulting, since the sweep was requested
+    if (!bCanVault || bIsVaulting || !IsLocallyControlled() || !GetCharacterMovement()->IsFalling())
+        return;
 
-        float TraceLength = SecondaryVaultStartLocation.Z - VaultHit.ImpactPoint.Z;
-        if (!bInitialSwitch)
-        {
-            InitialTraceHeight = TraceLength;
-            bInitialSwitch = true;
-        }
+    if (TraceData.OutHits.Num() == 0 || !TraceData.OutHits[0].bBlockingHit)
+        return;
 
-        PreviousTraceHeight = CurrentTraceHeight;
-        CurrentTraceHeight = TraceLength;
-        if (!(!(FMath::IsNearlyEqual(CurrentTraceHeight, InitialTraceHeight, 20.0f)) && CurrentTraceHeight < MaxMantleHeight))
-            continue;
+    // Looking for a ledge on top of the wall from where we were when we found it
+    FVaultLedge Ledge;
+    if (FPSCore::TraceVaultLedgeFromWall(GetWorld(), TraceData.OutHits[0], VaultTraceLocation, VaultTraceForward, GetVaultLedgeSettings(), GetVaultQueryParams(), Ledge, bDrawDebug))
+    {
+        VaultToLedge(Ledge);
+    }
+}
 
-        if (!FMath::IsNearlyEqual(PreviousTraceHeight, CurrentTraceHeight, 3.0f))
-            continue;
+void AFPSCharacter::VaultToLedge(const FVaultLedge &Ledge)
+{
+    VaultTargetLocation = FTransform(UKismetMathLibrary::MakeRotFromX(-Ledge.WallNormal), GetVaultTargetLocation(Ledge));
+    bIsVaulting = true;
+    Vault(VaultTargetLocation);
+}
 
-        FVector DownTracePoint = VaultHit.Location;
-        DownTracePoint.Z = VaultHit.ImpactPoint.Z;
+FCollisionQueryParams AFPSCharacter::GetVaultQueryParams() const
+{
+    FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(CharacterVault), true);
+    TraceParams.AddIgnoredActor(this);
+    return TraceParams;
+}
 
-        FVector CalculationVector = FVector::ZeroVector;
-        CalculationVector.Z = CalculationHeight;
-        DownTracePoint += CalculationVector;
-        StartLocation = DownTracePoint;
-        StartLocation.Z += ScaledCapsuleWithoutHemisphere;
-        EndLocation = DownTracePoint;
-        EndLocation.Z -= ScaledCapsuleWithoutHemisphere;
+FVector AFPSCharacter::GetVaultTargetLocation(const FVaultLedge &Ledge) const
+{
+    // Vaulting (or mantling) so that we stand on the floor that the ledge leads to
+    FVector TargetLocation = Ledge.LandingLocation;
+    TargetLocation.Z += GetCapsuleComponent()->GetScaledCapsuleHalfHeight() + 2;
+    return TargetLocation;
+}
 
-        if (bDrawDebug)
-        {
-            DrawDebugCapsule(GetWorld(), StartLocation, GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight(), GetCapsuleComponent()->GetUnscaledCapsuleRadius(), FQuat::Identity, FColor::Green, false, 10.0f);
-        }
-        if (GetWorld()->SweepSingleByChannel(VaultHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeSphere(GetCapsuleComponent()->GetUnscaledCapsuleRadius()), TraceParams))
-            continue;
+bool AFPSCharacter::ValidateVaultTarget(const FVector &TargetLocation, FVector &OutTargetLocation) const
+{
+    const FVector ColliderLocation = GetCapsuleComponent()->GetComponentLocation();
+    const FVaultLedgeSettings Settings = GetVaultLedgeSettings();
 
-        // If we find such a location, break the loop and vault
-        ForwardImpactNormal.X -= 1;
-        ForwardImpactNormal.Y -= 1;
-        VaultTargetLocation = FTransform(UKismetMathLibrary::MakeRotFromX(ForwardImpactNormal), DownTracePoint);
-        bIsVaulting = true;
-        Vault(VaultTargetLocation);
-        bVaultFailed = false;
-        break;
+    // Rejecting targets that no ledge search could have reached before tracing anything: the wall sweep, followed by
+    // every step over the top of the wall, and no higher than the top of the ledge check or lower than a mantle drop
+    const FVector Offset = TargetLocation - ColliderLocation;
+    const float MaxHorizontalReach = FVaultLedgeSettings::WallCheckRadius + FVaultLedgeSettings::WallCheckDistance + 5.0f * (Settings.VaultTraceAmount + 1) + VaultTargetTolerance;
+    const float MaxHeightAbove = FVaultLedgeSettings::LedgeCheckHeight + Settings.CapsuleHalfHeight + 2.0f + VaultTargetTolerance;
+    const float MaxHeightBelow = Settings.MaxMantleHeight + VaultTargetTolerance;
+    if (Offset.SizeSquared2D() > FMath::Square(MaxHorizontalReach) || Offset.Z > MaxHeightAbove || Offset.Z < -MaxHeightBelow)
+    {
+        return false;
     }
 
-    if (!bVaultFailed)
-        return;
-
-    // If the vault has failed (there is no space or the surface is too high), we proceed to perform the mantle logic
-
-    FVector DownTracePoint = MantleHit.Location;
-    DownTracePoint.Z = MantleHit.ImpactPoint.Z;
-
-    FVector CalculationVector = FVector::ZeroVector;
-    CalculationVector.Z = GetCapsuleComponent()->GetScaledCapsuleHalfHeight() + 2;
-    DownTracePoint += CalculationVector;
-    StartLocation = DownTracePoint;
-    StartLocation.Z += GetCapsuleComponent()->GetScaledCapsuleHalfHeight_WithoutHemisphere();
-    EndLocation = DownTracePoint;
-    EndLocation.Z -= GetCapsuleComponent()->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+    // Finding the ledge ourselves, looking towards the target from where we see the character. Baked ledges only cover
+    // static geometry, so we trace when they have nothing in front of the character
+    const FVector Forward = Offset.GetSafeNormal2D();
+    FVaultLedge Ledge;
+    const UVaultLedgeSubsystem *LedgeSubsystem = GetWorld()->GetSubsystem<UVaultLedgeSubsystem>();
+    const EVaultLedgeLookup Lookup = LedgeSubsystem ? LedgeSubsystem->FindLedge(ColliderLocation, Forward, Settings, Ledge) : EVaultLedgeLookup::Unbaked;
+    if (Lookup != EVaultLedgeLookup::Found && !FPSCore::TraceVaultLedge(GetWorld(), ColliderLocation, Forward, Settings, GetVaultQueryParams(), Ledge))
+    {
+        return false;
+    }
 
-    // Looking for a safe place to mantle to
-    if (GetWorld()->SweepSingleByChannel(MantleHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic,
-                                         FCollisionShape::MakeSphere(GetCapsuleComponent()->GetUnscaledCapsuleRadius()),
-                                         TraceParams))
-        return;
+    // Keeping the client's target when it agrees with ours, so that the client is not corrected for small differences
+    const FVector ServerTargetLocation = GetVaultTargetLocation(Ledge);
+    OutTargetLocation = FVector::DistSquared(TargetLocation, ServerTargetLocation) <= FMath::Square(VaultTargetTolerance) ? TargetLocation : ServerTargetLocation;
+    return true;
+}
 
-    ForwardImpactNormal.X -= 1;
-    ForwardImpactNormal.Y -= 1;
-    VaultTargetLocation = FTransform(UKismetMathLibrary::MakeRotFromX(ForwardImpactNormal), DownTracePoint);
-    bIsVaulting = true;
+FVaultLedgeSettings AFPSCharacter::GetVaultLedgeSettings() const
+{
+    FVaultLedgeSettings Settings;
+    Settings.CapsuleRadius = GetCapsuleComponent()->GetScaledCapsuleRadius();
+    Settings.CapsuleHalfHeight = GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+    Settings.MaxMantleHeight = MaxMantleHeight;
+    Settings.VaultTraceAmount = VaultTraceAmount;
+    Settings.VaultSpaceHeight = VaultSpaceHeight;
+    Settings.WalkableFloorZ = GetCharacterMovement()->GetWalkableFloorZ();
+    return Settings;
+}
 
-    // Calling vault with our mantle target point
-    Vault(VaultTargetLocation);
+float AFPSCharacter::GetVaultDuration() const
+{
+    float MinTime = 0.0f;
+    float MaxTime = 0.0f;
+    if (VaultTimelineCurve)
+    {
+        VaultTimelineCurve->GetTimeRange(MinTime, MaxTime);
+    }
+    return MaxTime - MinTime;
 }
 
-// Progresses the timeline that is used to vault the character
-void AFPSCharacter::TimelineProgress(const float Value)
+// Called once the movement component has moved the character to the target of its vault
+void AFPSCharacter::OnVaultFinished()
 {
-    const FVector NewLocation = FMath::Lerp(VaultStartLocation.GetLocation(), VaultEndLocation.GetLocation(), Value);
-    SetActorLocation(NewLocation);
-    if (Value == 1)
+    bIsVaulting = false;
+    if (!bWantsToWalk)
     {
-        bIsVaulting = false;
-        if (!bWantsToWalk)
-        {
-            UpdateMovementState(EMovementState::State_Sprint);
-        }
-        else
-        {
-            UpdateMovementState(EMovementState::State_Walk);
-        }
+        UpdateMovementState(EMovementState::State_Sprint);
+    }
+    else
+    {
+        UpdateMovementState(EMovementState::State_Walk);
     }
 }
 
 void AFPSCharacter::CheckGroundAngle(float DeltaTime)
 {
-    FCollisionQueryParams TraceParams;
-    TraceParams.bTraceComplex = true;
-    TraceParams.AddIgnoredActor(this);
+    FVector FloorVector;
 
-    // Determines the angle of the floor from the vector of a hit line trace
-    FVector CapsuleHeight = GetCapsuleComponent()->GetComponentLocation();
-    CapsuleHeight.Z -= GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
-    const FVector AngleStartTrace = CapsuleHeight;
-    FVector AngleEndTrace = AngleStartTrace;
-    AngleEndTrace.Z -= 50;
-    if (GetWorld()->LineTraceSingleByChannel(AngleHit, AngleStartTrace, AngleEndTrace, ECC_WorldStatic, TraceParams))
-    {
-        const FVector FloorVector = AngleHit.ImpactNormal;
-        const FRotator FinalRotation = UKismetMathLibrary::MakeRotFromZX(FloorVector, GetActorForwardVector());
-        FloorAngle = FinalRotation.Pitch;
-        if (bDrawDebug)
+    // Reusing the floor that the movement component has found this frame while we are on the ground
+    const UCharacterMovementComponent *Movement = GetCharacterMovement();
+    if (Movement->IsMovingOnGround() && Movement->CurrentFloor.bBlockingHit)
+    {
+        FloorVector = Movement->CurrentFloor.HitResult.ImpactNormal;
+    }
+    else
+    {
+        FCollisionQueryParams TraceParams;
+        TraceParams.bTraceComplex = true;
+        TraceParams.AddIgnoredActor(this);
+
+        // Determines the angle of the floor from the vector of a hit line trace
+        FVector CapsuleHeight = GetCapsuleComponent()->GetComponentLocation();
+        CapsuleHeight.Z -= GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+        const FVector AngleStartTrace = CapsuleHeight;
+        FVector AngleEndTrace = AngleStartTrace;
+        AngleEndTrace.Z -= 50;
+        if (!GetWorld()->LineTraceSingleByChannel(AngleHit, AngleStartTrace, AngleEndTrace, ECC_WorldStatic, TraceParams))
         {
-            GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::Printf(TEXT("Current floor angle = %f"), FloorAngle), true);
+            return;
         }
+        FloorVector = AngleHit.ImpactNormal;
+    }
+
+    const FRotator FinalRotation = UKismetMathLibrary::MakeRotFromZX(FloorVector, GetActorForwardVector());
+    FloorAngle = FinalRotation.Pitch;
+    if (bDrawDebug)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::Printf(TEXT("Current floor angle = %f"), FloorAngle), true);
     }
 }
 
@@ -562,294 +643,199 @@ float AFPSCharacter::CheckRelativeMovementAngle(const float DeltaTime) const
 
 bool AFPSCharacter::HasSpaceToStandUp()
 {
-    FVector CenterVector = GetActorLocation();
-    CenterVector.Z += 44;
-
-    const float CollisionCapsuleHeight = DefaultCapsuleHalfHeight - 17.0f;
-
-    // Check to see if a capsule collision collides with the environment, if yes, we don't have space to stand up
-    const FCollisionShape CollisionCapsule = FCollisionShape::MakeCapsule(30.0f, CollisionCapsuleHeight);
-
-    if (bDrawDebug)
+    // Crouching, walking and sliding can all ask in the same frame, and the answer does not change within one
+    if (StandUpResultFrame == GFrameCounter)
     {
-        DrawDebugCapsule(GetWorld(), CenterVector, CollisionCapsuleHeight, 30.0f, FQuat::Identity, FColor::Red, false, 5.0f, 0, 3);
+        return bHasSpaceToStandUp;
     }
+    StandUpResultFrame = GFrameCounter;
 
-    FCollisionQueryParams QueryParams;
-    QueryParams.AddIgnoredActor(this);
+    const FVector CenterVector = GetStandUpCheckLocation();
 
-    if (GetWorld()->SweepSingleByChannel(StandUpHit, CenterVector, CenterVector, FQuat::Identity, ECC_WorldStatic, CollisionCapsule, QueryParams))
+    // The async check requested while we were crouched or sliding answers for us, as long as we have barely moved since
+    if (StandUpTraceFrame > 0 && StandUpTraceFrame + 1 >= GFrameCounter && FVector::DistSquared(CenterVector, StandUpTraceLocation) <= FMath::Square(StandUpCheckTolerance))
     {
-        /* confetti or smth idk */
+        bHasSpaceToStandUp = bStandUpTraceResult;
+    }
+    else
+    {
+        INC_DWORD_STAT(STAT_CharacterStandUpSweeps);
+
         if (bDrawDebug)
         {
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, "Stand up trace returned hit", true);
+            DrawDebugCapsule(GetWorld(), CenterVector, DefaultCapsuleHalfHeight - 17.0f, 30.0f, FQuat::Identity, FColor::Red, false, 5.0f, 0, 3);
         }
-        return false;
-    }
 
-    return true;
-}
+        // Check to see if a capsule collision collides with the environment, if yes, we don't have space to stand up
+        FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(CharacterStandUp));
+        QueryParams.AddIgnoredActor(this);
+        bHasSpaceToStandUp = !GetWorld()->SweepSingleByChannel(StandUpHit, CenterVector, CenterVector, FQuat::Identity, ECC_WorldStatic, GetStandUpCheckShape(), QueryParams);
+    }
 
-void AFPSCharacter::Vault(const FTransform TargetTransform)
-{
-    // Updating our target location and playing the vault timeline from start
-    VaultStartLocation = GetActorTransform();
-    VaultEndLocation = TargetTransform;
-    UpdateMovementState(EMovementState::State_Vault);
-    if (VaultMontage)
+    if (!bHasSpaceToStandUp && bDrawDebug)
     {
-        HandsMeshComp->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
-        ThirdPersonMesh->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
-        if (!IsNetMode(NM_DedicatedServer) && !IsNetMode(NM_ListenServer))
-        {
-            Server_Vault(TargetTransform);
-        }
-        Multi_Vault(TargetTransform);
+        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, "Stand up trace returned hit", true);
     }
-    VaultTimeline.PlayFromStart();
+    return bHasSpaceToStandUp;
 }
 
-void AFPSCharacter::Server_Vault_Implementation(const FTransform TargetTransform)
+void AFPSCharacter::RequestStandUpCheck()
 {
-    // Updating our target location and playing the vault timeline from start
-    VaultStartLocation = GetActorTransform();
-    VaultEndLocation = TargetTransform;
-    UpdateMovementState(EMovementState::State_Vault);
-    if (VaultMontage)
+    if (bStandUpTraceInFlight)
     {
-        HandsMeshComp->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
-        ThirdPersonMesh->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
+        return;
     }
-    VaultTimeline.PlayFromStart();
+
+    // Checked with the async trace system, so that the answer is ready by the time that we try to stand up
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(CharacterStandUp));
+    QueryParams.AddIgnoredActor(this);
+    const FVector CenterVector = GetStandUpCheckLocation();
+    PendingStandUpTraceLocation = CenterVector;
+    bStandUpTraceInFlight = true;
+    GetWorld()->AsyncSweepByChannel(EAsyncTraceType::Single, CenterVector, CenterVector, FQuat::Identity, ECC_WorldStatic, GetStandUpCheckShape(), QueryParams, FCollisionResponseParams::DefaultResponseParam, &StandUpTraceDelegate);
 }
 
-void AFPSCharacter::Multi_Vault_Implementation(const FTransform TargetTransform)
+void AFPSCharacter::OnStandUpTraced(const FTraceHandle &TraceHandle, FTraceDatum &TraceData)
 {
-    // Updating our target location and playing the vault timeline from start
-    VaultStartLocation = GetActorTransform();
-    VaultEndLocation = TargetTransform;
-    UpdateMovementState(EMovementState::State_Vault);
-    if (VaultMontage)
-    {
-        HandsMeshComp->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
-        ThirdPersonMesh->GetAnimInstance()->Montage_Play(VaultMontage, 1.0f);
-    }
-    VaultTimeline.PlayFromStart();
+    bStandUpTraceInFlight = false;
+    bStandUpTraceResult = TraceData.OutHits.Num() == 0 || !TraceData.OutHits[0].bBlockingHit;
+    StandUpTraceLocation = PendingStandUpTraceLocation;
+    StandUpTraceFrame = GFrameCounter;
 }
 
-void AFPSCharacter::Multi_UpdateMovementState_Implementation(const EMovementState NewMovementState)
+FVector AFPSCharacter::GetStandUpCheckLocation() const
 {
-    // Clearing sprinting and crouching flags
-    bIsSprinting = false;
-    bIsCrouching = false;
-    bIsWalking = false;
-    bIsVaulting = false;
-    bIsSliding = false;
+    FVector CenterVector = GetActorLocation();
+    CenterVector.Z += 44;
+    return CenterVector;
+}
 
-    // Updating the movement state
-    MovementState = NewMovementState;
+FCollisionShape AFPSCharacter::GetStandUpCheckShape() const
+{
+    return FCollisionShape::MakeCapsule(30.0f, DefaultCapsuleHalfHeight - 17.0f);
+}
 
-    if (MovementDataMap.Contains(MovementState))
+void AFPSCharacter::Vault(const FTransform TargetTransform)
+{
+    // The movement component moves us to the target with a root motion source, starting with the move that requests
+    // the vault state, so the server only needs to be told the target once
+    if (UFPSCharacterMovementComponent *FPSCharacterMovement = GetFPSCharacterMovement())
     {
-        // Updating CharacterMovementComponent variables based on movement state
-        if (InventoryComponent)
+        FPSCharacterMovement->SetVaultTarget(TargetTransform.GetLocation());
+        UpdateMovementState(EMovementState::State_Vault);
+        if (!HasAuthority())
         {
-            if (InventoryComponent->GetCurrentWeapon())
-            {
-                // Check if AnimationWaitDelay timer is active and get its remaining time
-                float RemainingTime = 0.0f;
-                ActiveTimer = InventoryComponent->GetCurrentWeapon()->GetAnimationWaitDelay();
-                RemainingTime = GetWorld()->GetTimerManager().GetTimerRemaining(ActiveTimer);
-                if (GetWorld()->GetTimerManager().IsTimerActive(ActiveTimer))
-                {
-                    FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &AFPSCharacter::EnableWeaponFire);
-                    if (!GetWorld()->GetTimerManager().IsTimerActive(WaitForAnim))
-                    {
-                        GetWorld()->GetTimerManager().ClearTimer(WaitForAnim);
-                        GetWorld()->GetTimerManager().SetTimer(WaitForAnim, TimerDelegate, RemainingTime, false);
-                    }
-                }
-                else
-                {
-                    InventoryComponent->GetCurrentWeapon()->SetCanFire(MovementDataMap[MovementState].bCanFire);
-                }
-                InventoryComponent->GetCurrentWeapon()->SetCanReload(MovementDataMap[MovementState].bCanReload);
-            }
+            Server_Vault(TargetTransform.GetLocation());
         }
-        GetCharacterMovement()->MaxAcceleration = MovementDataMap[MovementState].MaxAcceleration;
-        GetCharacterMovement()->BrakingDecelerationWalking = MovementDataMap[MovementState].BreakingDecelerationWalking;
-        GetCharacterMovement()->GroundFriction = MovementDataMap[MovementState].GroundFriction;
-        GetCharacterMovement()->MaxWalkSpeed = MovementDataMap[MovementState].MaxWalkSpeed;
     }
+}
 
-    // Updating sprinting and crouching flags
-    if (MovementState == EMovementState::State_Crouch)
+void AFPSCharacter::Server_Vault_Implementation(const FVector_NetQuantize10 TargetLocation)
+{
+    // The vault moves the character straight to its target, so targets have to be checked before they are used. Without
+    // a target the server never starts the vault, and corrects the client instead
+    FVector ValidTargetLocation;
+    if (!ValidateVaultTarget(TargetLocation, ValidTargetLocation))
     {
-        bIsCrouching = true;
+        UE_LOG(LogProfilingDebugging, Warning, TEXT("Rejected a vault target of %s that is out of reach or has no ledge"), *GetName());
+        Client_RejectVault(TargetLocation);
+        return;
     }
-    if (MovementState == EMovementState::State_Sprint)
+
+    if (UFPSCharacterMovementComponent *FPSCharacterMovement = GetFPSCharacterMovement())
     {
-        bIsSprinting = true;
+        FPSCharacterMovement->SetVaultTarget(ValidTargetLocation);
     }
-    if (MovementState == EMovementState::State_Walk)
+}
+
+void AFPSCharacter::Client_RejectVault_Implementation(const FVector_NetQuantize10 TargetLocation)
+{
+    // Stopping the vault that we are predicting, which the server will never perform
+    if (UFPSCharacterMovementComponent *FPSCharacterMovement = GetFPSCharacterMovement())
     {
-        bIsWalking = true;
+        FPSCharacterMovement->CancelVault(TargetLocation);
     }
-    if (MovementState == EMovementState::State_Vault)
+}
+
+// Requests a new movement state, which the movement component predicts and sends to the server with our moves
+void AFPSCharacter::UpdateMovementState(const EMovementState NewMovementState)
+{
+    // The server follows the states requested by the moves of remote players
+    if (!IsLocallyControlled())
     {
-        bIsVaulting = true;
+        return;
     }
-    if (MovementState == EMovementState::State_Slide)
+
+    if (UFPSCharacterMovementComponent *FPSCharacterMovement = GetFPSCharacterMovement())
     {
-        bIsSliding = true;
+        FPSCharacterMovement->SetRequestedMovementState(NewMovementState);
     }
 }
 
-void AFPSCharacter::Server_UpdateMovementState_Implementation(const EMovementState NewMovementState)
+// Function that updates the movement state, called by the movement component's moves
+void AFPSCharacter::SetMovementState(const EMovementState NewMovementState)
 {
-    // Clearing sprinting and crouching flags
-    bIsSprinting = false;
-    bIsCrouching = false;
-    bIsWalking = false;
-    bIsVaulting = false;
-    bIsSliding = false;
-
     // Updating the movement state
+    const EMovementState PreviousMovementState = MovementState;
     MovementState = NewMovementState;
+    MARK_PROPERTY_DIRTY_FROM_NAME(AFPSCharacter, MovementState, this);
 
-    if (MovementDataMap.Contains(MovementState))
-    {
-        // Updating CharacterMovementComponent variables based on movement state
-        if (InventoryComponent)
-        {
-            if (InventoryComponent->GetCurrentWeapon())
-            {
-                // Check if AnimationWaitDelay timer is active and get its remaining time
-                float RemainingTime = 0.0f;
-                ActiveTimer = InventoryComponent->GetCurrentWeapon()->GetAnimationWaitDelay();
-                RemainingTime = GetWorld()->GetTimerManager().GetTimerRemaining(ActiveTimer);
-                if (GetWorld()->GetTimerManager().IsTimerActive(ActiveTimer))
-                {
-                    FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &AFPSCharacter::EnableWeaponFire);
-                    if (!GetWorld()->GetTimerManager().IsTimerActive(WaitForAnim))
-                    {
-                        GetWorld()->GetTimerManager().ClearTimer(WaitForAnim);
-                        GetWorld()->GetTimerManager().SetTimer(WaitForAnim, TimerDelegate, RemainingTime, false);
-                    }
-                }
-                else
-                {
-                    InventoryComponent->GetCurrentWeapon()->SetCanFire(MovementDataMap[MovementState].bCanFire);
-                }
-                InventoryComponent->GetCurrentWeapon()->SetCanReload(MovementDataMap[MovementState].bCanReload);
-            }
-        }
-        GetCharacterMovement()->MaxAcceleration = MovementDataMap[MovementState].MaxAcceleration;
-        GetCharacterMovement()->BrakingDecelerationWalking = MovementDataMap[MovementState].BreakingDecelerationWalking;
-        GetCharacterMovement()->GroundFriction = MovementDataMap[MovementState].GroundFriction;
-        GetCharacterMovement()->MaxWalkSpeed = MovementDataMap[MovementState].MaxWalkSpeed;
-    }
+    OnMovementStateChanged(PreviousMovementState);
+}
 
-    // Updating sprinting and crouching flags
-    if (MovementState == EMovementState::State_Crouch)
-    {
-        bIsCrouching = true;
-    }
-    if (MovementState == EMovementState::State_Sprint)
-    {
-        bIsSprinting = true;
-    }
-    if (MovementState == EMovementState::State_Walk)
-    {
-        bIsWalking = true;
-    }
-    if (MovementState == EMovementState::State_Vault)
-    {
-        bIsVaulting = true;
-    }
-    if (MovementState == EMovementState::State_Slide)
-    {
-        bIsSliding = true;
-    }
-    Multi_UpdateMovementState(NewMovementState);
+void AFPSCharacter::OnRep_MovementState(const EMovementState PreviousMovementState)
+{
+    OnMovementStateChanged(PreviousMovementState);
 }
 
-// Function that determines the player's maximum speed and other related variables based on movement state
-void AFPSCharacter::UpdateMovementState(const EMovementState NewMovementState)
+// Function that updates the flags, weapon restrictions and animations that depend on the movement state
+void AFPSCharacter::OnMovementStateChanged(const EMovementState PreviousMovementState)
 {
-    // Clearing sprinting and crouching flags
-    bIsSprinting = false;
-    bIsCrouching = false;
-    bIsWalking = false;
-    bIsVaulting = false;
-    bIsSliding = false;
+    // Updating sprinting and crouching flags
+    bIsSprinting = MovementState == EMovementState::State_Sprint;
+    bIsCrouching = MovementState == EMovementState::State_Crouch;
+    bIsWalking = MovementState == EMovementState::State_Walk;
+    bIsVaulting = MovementState == EMovementState::State_Vault;
+    bIsSliding = MovementState == EMovementState::State_Slide;
 
-    // Updating the movement state
-    MovementState = NewMovementState;
+    UpdateWeaponMovementRestrictions();
 
-    if (MovementDataMap.Contains(MovementState))
+    // Playing the vault animation as the vault starts, on every machine that the state reaches
+    if (MovementState == EMovementState::State_Vault && PreviousMovementState != EMovementState::State_Vault && VaultMontage)
     {
-        // Updating CharacterMovementComponent variables based on movement state
-        if (InventoryComponent)
+        if (FPSCore::ShouldPlayCosmetics(this))
         {
-            if (InventoryComponent->GetCurrentWeapon())
-            {
-                // Check if AnimationWaitDelay timer is active and get its remaining time
-                float RemainingTime = 0.0f;
-                ActiveTimer = InventoryComponent->GetCurrentWeapon()->GetAnimationWaitDelay();
-                RemainingTime = GetWorld()->GetTimerManager().GetTimerRemaining(ActiveTimer);
-                if (GetWorld()->GetTimerManager().IsTimerActive(ActiveTimer))
-                {
-                    FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &AFPSCharacter::EnableWeaponFire);
-                    if (!GetWorld()->GetTimerManager().IsTimerActive(WaitForAnim))
-                    {
-                        GetWorld()->GetTimerManager().ClearTimer(WaitForAnim);
-                        GetWorld()->GetTimerManager().SetTimer(WaitForAnim, TimerDelegate, RemainingTime, false);
-                    }
-                }
-                else
-                {
-                    InventoryComponent->GetCurrentWeapon()->SetCanFire(MovementDataMap[MovementState].bCanFire);
-                }
-                InventoryComponent->GetCurrentWeapon()->SetCanReload(MovementDataMap[MovementState].bCanReload);
-            }
+            FPSCore::PlayMontage(HandsMeshComp, VaultMontage);
         }
-        GetCharacterMovement()->MaxAcceleration = MovementDataMap[MovementState].MaxAcceleration;
-        GetCharacterMovement()->BrakingDecelerationWalking = MovementDataMap[MovementState].BreakingDecelerationWalking;
-        GetCharacterMovement()->GroundFriction = MovementDataMap[MovementState].GroundFriction;
-        GetCharacterMovement()->MaxWalkSpeed = MovementDataMap[MovementState].MaxWalkSpeed;
+        FPSCore::PlayMontage(ThirdPersonMesh, VaultMontage);
     }
+}
 
-    // Updating sprinting and crouching flags
-    if (MovementState == EMovementState::State_Crouch)
-    {
-        bIsCrouching = true;
-    }
-    if (MovementState == EMovementState::State_Sprint)
-    {
-        bIsSprinting = true;
-    }
-    if (MovementState == EMovementState::State_Walk)
-    {
-        bIsWalking = true;
-    }
-    if (MovementState == EMovementState::State_Vault)
-    {
-        bIsVaulting = true;
-    }
-    if (MovementState == EMovementState::State_Slide)
+void AFPSCharacter::UpdateWeaponMovementRestrictions()
+{
+    if (!MovementDataMap.Contains(MovementState) || !InventoryComponent || !InventoryComponent->GetCurrentWeapon())
     {
-        bIsSliding = true;
+        return;
     }
-    if (!HasAuthority())
+
+    // Check if AnimationWaitDelay timer is active and get its remaining time
+    float RemainingTime = 0.0f;
+    ActiveTimer = InventoryComponent->GetCurrentWeapon()->GetAnimationWaitDelay();
+    RemainingTime = GetWorld()->GetTimerManager().GetTimerRemaining(ActiveTimer);
+    if (GetWorld()->GetTimerManager().IsTimerActive(ActiveTimer))
     {
-        Server_UpdateMovementState(NewMovementState);
+        FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &AFPSCharacter::EnableWeaponFire);
+        if (!GetWorld()->GetTimerManager().IsTimerActive(WaitForAnim))
+        {
+            GetWorld()->GetTimerManager().ClearTimer(WaitForAnim);
+            GetWorld()->GetTimerManager().SetTimer(WaitForAnim, TimerDelegate, RemainingTime, false);
+        }
     }
     else
     {
-        Multi_UpdateMovementState(NewMovementState);
+        InventoryComponent->GetCurrentWeapon()->SetCanFire(MovementDataMap[MovementState].bCanFire);
     }
+    InventoryComponent->GetCurrentWeapon()->SetCanReload(MovementDataMap[MovementState].bCanReload);
 }
 
 void AFPSCharacter::EnableWeaponFire()
@@ -860,60 +846,133 @@ void AFPSCharacter::EnableWeaponFire()
     }
 }
 
-void AFPSCharacter::Server_VaultTimelineTick_Implementation(const float DeltaTime)
+// Called every frame
+void AFPSCharacter::Tick(const float DeltaTime)
 {
-    VaultTimeline.TickTimeline(DeltaTime);
+    Super::Tick(DeltaTime);
+
+    for (FCharacterTickTask &Task : TickTasks)
+    {
+        Task.TimeSinceLastRun += DeltaTime;
+        if (Task.TimeSinceLastRun < Task.Interval)
+        {
+            continue;
+        }
+
+        // Skipped tasks run as soon as they have something to update again, catching up on no more than one interval
+        if (!PassesNetFilter(Task.NetFilter) || (Task.IsDirty && !Task.IsDirty()))
+        {
+            Task.TimeSinceLastRun = Task.Interval;
+            continue;
+        }
+
+        FScopeCycleCounter TaskCycleCounter(Task.StatId);
+        Task.Run(Task.TimeSinceLastRun);
+        Task.TimeSinceLastRun = 0.0f;
+        INC_DWORD_STAT(STAT_CharacterTickTasksRun);
+    }
 }
 
-void AFPSCharacter::Multi_VaultTimelineTick_Implementation(const float DeltaTime)
+void AFPSCharacter::RegisterTickTasks()
 {
-    VaultTimeline.TickTimeline(DeltaTime);
+    TickTasks.Reset();
+
+    // The camera is moved on every machine, as the server aims automatic fire from it
+    RegisterTickTask(GET_STATID(STAT_CharacterCameraOffset), ECharacterTickNetFilter::All, 0.0f,
+        [this](const float DeltaTime) { UpdateCameraOffset(DeltaTime); },
+        [this]() { return CurrentCameraOffset != GetTargetCameraOffset(); });
+
+    // Movement states are decided by the player controlling the character, so only they need to check when to change them
+    RegisterTickTask(GET_STATID(STAT_CharacterSprintAngle), ECharacterTickNetFilter::LocallyControlled, SprintAngleCheckInterval,
+        [this](const float DeltaTime) { UpdateSprintAngle(DeltaTime); },
+        [this]() { return bRestrictSprintAngle && (MovementState == EMovementState::State_Sprint || bRestrictingSprint); });
+
+    RegisterTickTask(GET_STATID(STAT_CharacterSlideOnLanding), ECharacterTickNetFilter::LocallyControlled, 0.0f,
+        [this](float) { CheckSlideOnLanding(); },
+        [this]() { return bWantsToSlide && !bPerformedSlide; });
+
+    RegisterTickTask(GET_STATID(STAT_CharacterVaultCheck), ECharacterTickNetFilter::LocallyControlled, VaultCheckInterval,
+        [this](float) { CheckVault(); },
+        [this]() { return bCanVault; });
+
+    // Whether we can stand up is only asked by the player controlling the character, while crouched or sliding
+    RegisterTickTask(GET_STATID(STAT_CharacterStandUpCheck), ECharacterTickNetFilter::LocallyControlled, 0.0f,
+        [this](float) { RequestStandUpCheck(); },
+        [this]() { return MovementState == EMovementState::State_Crouch || MovementState == EMovementState::State_Slide; });
+
+    // The floor angle decides whether slides continue, which only the player controlling the character does
+    RegisterTickTask(GET_STATID(STAT_CharacterGroundAngle), ECharacterTickNetFilter::LocallyControlled, GroundAngleCheckInterval,
+        [this](const float DeltaTime) { CheckGroundAngle(DeltaTime); });
+
+    // Only the player's own camera is ever looked through, so there is no field of view to update elsewhere
+    RegisterTickTask(GET_STATID(STAT_CharacterFieldOfView), ECharacterTickNetFilter::LocallyControlled, 0.0f,
+        [this](const float DeltaTime) { UpdateFieldOfView(DeltaTime); });
+
+    // Continuous aiming check (so that you don't have to re-press the ADS button every time you jump/sprint/reload/etc)
+    RegisterTickTask(GET_STATID(STAT_CharacterAiming), ECharacterTickNetFilter::All, 0.0f,
+        [this](float) { bIsAiming = bWantsToAim && MovementState != EMovementState::State_Slide; });
+
+    RegisterTickTask(GET_STATID(STAT_CharacterDebug), ECharacterTickNetFilter::All, 0.0f,
+        [this](const float DeltaTime) { DrawWeaponDebug(DeltaTime); },
+        [this]() { return bDrawDebug; });
 }
 
-// Called every frame
-void AFPSCharacter::Tick(const float DeltaTime)
+void AFPSCharacter::RegisterTickTask(const TStatId StatId, const ECharacterTickNetFilter NetFilter, const float Interval, TFunction<void(float)> &&Run, TFunction<bool()> &&IsDirty)
 {
-    Super::Tick(DeltaTime);
+    FCharacterTickTask &Task = TickTasks.AddDefaulted_GetRef();
+    Task.Run = MoveTemp(Run);
+    Task.IsDirty = MoveTemp(IsDirty);
+    Task.NetFilter = NetFilter;
+    Task.Interval = Interval;
+    Task.StatId = StatId;
+}
 
-    // Timeline tick
-    VaultTimeline.TickTimeline(DeltaTime);
-    Multi_VaultTimelineTick(DeltaTime);
-    if (!IsNetMode(NM_DedicatedServer) && !IsNetMode(NM_ListenServer))
+bool AFPSCharacter::PassesNetFilter(const ECharacterTickNetFilter NetFilter) const
+{
+    switch (NetFilter)
     {
-        Server_VaultTimelineTick(DeltaTime);
+    case ECharacterTickNetFilter::LocallyControlled:
+        return IsLocallyControlled();
+    case ECharacterTickNetFilter::Authority:
+        return HasAuthority();
+    default:
+        return true;
     }
+}
 
-    // Crouching
-    // Sets the new Target Half Height based on whether the player is crouching or standing
-    const float TargetHalfHeight = (MovementState == EMovementState::State_Crouch || MovementState == EMovementState::State_Slide) ? CrouchedCapsuleHalfHeight : DefaultCapsuleHalfHeight;
-    const float CameraTargetOffset = (MovementState == EMovementState::State_Crouch || MovementState == EMovementState::State_Slide) ? DefaultCameraOffset + CrouchedCameraHeightDelta : DefaultCameraOffset;
-    // Interpolates between the current height and the target height
-    const float NewHalfHeight = FMath::FInterpTo(GetCapsuleComponent()->GetScaledCapsuleHalfHeight(), TargetHalfHeight, DeltaTime, CrouchSpeed);
-    const float NewLocation = FMath::FInterpTo(CurrentCameraOffset, CameraTargetOffset, DeltaTime, CrouchSpeed);
-    CurrentCameraOffset = NewLocation;
-    // Sets the half height of the capsule component to the new interpolated half height
-    GetCapsuleComponent()->SetCapsuleHalfHeight(NewHalfHeight);
+float AFPSCharacter::GetTargetCameraOffset() const
+{
+    // The capsule is resized by the movement component's predicted crouch, the camera interpolates to its new height
+    return bIsCrouched ? DefaultCameraOffset + CrouchedCameraHeightDelta : DefaultCameraOffset;
+}
+
+void AFPSCharacter::UpdateCameraOffset(const float DeltaTime)
+{
+    CurrentCameraOffset = FMath::FInterpTo(CurrentCameraOffset, GetTargetCameraOffset(), DeltaTime, CrouchSpeed);
     FVector NewCameraLocation = CameraComponent->GetRelativeLocation();
-    NewCameraLocation.Z = NewLocation;
+    NewCameraLocation.Z = CurrentCameraOffset;
     CameraComponent->SetRelativeLocation(NewCameraLocation);
+}
 
-    if (bRestrictSprintAngle)
-    {
-        const float CurrentRelativeMovementAngle = CheckRelativeMovementAngle(DeltaTime);
+void AFPSCharacter::UpdateSprintAngle(const float DeltaTime)
+{
+    const float CurrentRelativeMovementAngle = CheckRelativeMovementAngle(DeltaTime);
 
-        // Sprinting
-        if (CurrentRelativeMovementAngle > (SprintAngleLimit * (PI / 180)) && MovementState == EMovementState::State_Sprint)
-        {
-            UpdateMovementState(EMovementState::State_Walk);
-            bRestrictingSprint = true;
-        }
-        else if (CurrentRelativeMovementAngle < (SprintAngleLimit * (PI / 180)) && bRestrictingSprint && !bWantsToWalk)
-        {
-            UpdateMovementState(EMovementState::State_Sprint);
-            bRestrictingSprint = false;
-        }
+    // Sprinting
+    if (CurrentRelativeMovementAngle > (SprintAngleLimit * (PI / 180)) && MovementState == EMovementState::State_Sprint)
+    {
+        UpdateMovementState(EMovementState::State_Walk);
+        bRestrictingSprint = true;
     }
+    else if (CurrentRelativeMovementAngle < (SprintAngleLimit * (PI / 180)) && bRestrictingSprint && !bWantsToWalk)
+    {
+        UpdateMovementState(EMovementState::State_Sprint);
+        bRestrictingSprint = false;
+    }
+}
 
+void AFPSCharacter::UpdateFieldOfView(const float DeltaTime)
+{
     // FOV adjustments
     if (MovementDataMap.Contains(EMovementState::State_Walk))
     {
@@ -929,28 +988,23 @@ void AFPSCharacter::Tick(const float DeltaTime)
             }
         }
 
-        // Interpolates between current fov and target fov
+        // Interpolates between current fov and target fov, only touching the camera while it is changing
         const float InFieldOfView = FMath::FInterpTo(CameraComponent->FieldOfView, TargetFOV, DeltaTime, FOVChangeSpeed);
-        // Sets the new camera FOV
-        CameraComponent->SetFieldOfView(InFieldOfView);
+        if (InFieldOfView != CameraComponent->FieldOfView)
+        {
+            CameraComponent->SetFieldOfView(InFieldOfView);
+        }
     }
     else
     {
         UE_LOG(LogProfilingDebugging, Error, TEXT("Set up data in MovementDataMap! Fov adjustments"))
     }
+}
 
-    // Continuous aiming check (so that you don't have to re-press the ADS button every time you jump/sprint/reload/etc)
-    if (bWantsToAim == true && MovementState != EMovementState::State_Slide)
-    {
-        bIsAiming = true;
-    }
-    else
-    {
-        bIsAiming = false;
-    }
-
+void AFPSCharacter::CheckSlideOnLanding()
+{
     // Slide performed check, so that if the player is in the air and presses the slide key, they slide when they land
-    if (GetCharacterMovement()->IsMovingOnGround() && !bPerformedSlide && bWantsToSlide)
+    if (GetCharacterMovement()->IsMovingOnGround())
     {
         float ForwardVelocity = FVector::DotProduct(GetVelocity(), GetActorForwardVector());
         float RightVelocity = FVector::DotProduct(GetVelocity(), GetActorRightVector());
@@ -960,33 +1014,27 @@ void AFPSCharacter::Tick(const float DeltaTime)
             bWantsToSlide = false;
         }
     }
+}
 
-    // Checks whether we can vault every frame
-    CheckVault();
-
-    // Checks the floor angle to determine whether we should keep sliding or not
-    CheckGroundAngle(DeltaTime);
-
-    if (bDrawDebug)
+void AFPSCharacter::DrawWeaponDebug(const float DeltaTime) const
+{
+    if (InventoryComponent)
     {
-        if (InventoryComponent)
+        for (int Index = 0; Index < InventoryComponent->GetNumberOfWeaponSlots(); Index++)
         {
-            for (int Index = 0; Index < InventoryComponent->GetNumberOfWeaponSlots(); Index++)
+            if (InventoryComponent->GetEquippedWeapons().Contains(Index))
             {
-                if (InventoryComponent->GetEquippedWeapons().Contains(Index))
-                {
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->ClipSize));
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->ClipCapacity));
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->WeaponHealth));
-                }
-                else
-                {
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
-                    GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
-                }
-                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::FromInt(Index));
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->ClipSize));
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->ClipCapacity));
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::SanitizeFloat(InventoryComponent->GetEquippedWeapons()[Index]->GetRuntimeWeaponData()->WeaponHealth));
             }
+            else
+            {
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
+                GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, TEXT("No Weapon Found"));
+            }
+            GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Red, FString::FromInt(Index));
         }
     }
 }
@@ -1077,27 +1125,37 @@ void AFPSCharacter::Fire()
         {
             FVector CameraLocation = GetCameraComponent()->GetComponentLocation();
             FRotator CameraRotation = GetCameraComponent()->GetComponentRotation();
-            InventoryComponent->GetCurrentWeapon()->StartFire(CameraLocation, CameraRotation);
+            AWeaponBase *CurrentWeapon = InventoryComponent->GetCurrentWeapon();
+            CurrentWeapon->StartFire(CameraLocation, CameraRotation, GetWorld()->GetTimeSeconds(), CurrentWeapon->GetLastShotId() + 1);
         }
     }
-    else
+    else if (AWeaponBase *CurrentWeapon = InventoryComponent->GetCurrentWeapon())
     {
         FVector CameraLocation = GetCameraComponent()->GetComponentLocation();
         FRotator CameraRotation = GetCameraComponent()->GetComponentRotation();
-        Server_Fire(CameraLocation, CameraRotation);
+
+        // Firing locally straight away, the server will confirm or correct our shots afterwards
+        const uint16 FirstShotId = CurrentWeapon->GetLastShotId() + 1;
+        CurrentWeapon->StartPredictedFire(CameraLocation, CameraRotation);
+
+        // Sending the server time at which we saw the world, so that the server can rewind other players accordingly
+        const AGameStateBase *GameState = GetWorld()->GetGameState();
+        const double ClientTimestamp = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+        Server_Fire(CameraLocation, CameraRotation, ClientTimestamp, FirstShotId);
     }
 }
 
-bool AFPSCharacter::Server_Fire_Validate(FVector CameraLocation, FRotator CameraRotation)
+bool AFPSCharacter::Server_Fire_Validate(FVector CameraLocation, FRotator CameraRotation, double ClientTimestamp, uint16 FirstShotId)
 {
-    return true;
+    // Shot IDs are checked against the weapon's by AcknowledgeShots, as the client may have switched weapons since firing
+    return !CameraLocation.ContainsNaN() && !CameraRotation.ContainsNaN() && FMath::IsFinite(ClientTimestamp);
 }
 
-void AFPSCharacter::Server_Fire_Implementation(FVector CameraLocation, FRotator CameraRotation)
+void AFPSCharacter::Server_Fire_Implementation(FVector CameraLocation, FRotator CameraRotation, double ClientTimestamp, uint16 FirstShotId)
 {
     if (InventoryComponent->GetCurrentWeapon())
     {
-        InventoryComponent->GetCurrentWeapon()->StartFire(CameraLocation, CameraRotation);
+        InventoryComponent->GetCurrentWeapon()->StartFire(CameraLocation, CameraRotation, ClientTimestamp, FirstShotId);
     }
 }
 
@@ -1110,22 +1168,26 @@ void AFPSCharacter::StopFire()
             InventoryComponent->GetCurrentWeapon()->StopFire();
         }
     }
-    else
+    else if (AWeaponBase *CurrentWeapon = InventoryComponent->GetCurrentWeapon())
     {
-        Server_StopFire();
+        // Stopping our predicted fire locally, and letting the server know the last shot we fired
+        CurrentWeapon->StopFire();
+        Server_StopFire(CurrentWeapon->GetLastShotId());
     }
 }
 
-bool AFPSCharacter::Server_StopFire_Validate()
+bool AFPSCharacter::Server_StopFire_Validate(uint16 LastShotId)
 {
+    // Shot IDs are checked against the weapon's by AcknowledgeShots, as the client may have switched weapons since firing
     return true;
 }
 
-void AFPSCharacter::Server_StopFire_Implementation()
+void AFPSCharacter::Server_StopFire_Implementation(uint16 LastShotId)
 {
-    if (InventoryComponent->GetCurrentWeapon())
+    if (AWeaponBase *CurrentWeapon = InventoryComponent->GetCurrentWeapon())
     {
-        InventoryComponent->GetCurrentWeapon()->Client_StopFire();
+        CurrentWeapon->StopFire();
+        CurrentWeapon->AcknowledgeShots(LastShotId);
     }
 }
 
@@ -1,9 +1,25 @@
 // Copyright 2022 Ellie Kelemen. All Rights Reserved.
 
 #include "FPSCore.h"
+#include "Animation/AnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Actor.h"
 
 #define LOCTEXT_NAMESPACE "FFPSCoreModule"
 
+#if !UE_SERVER
+bool FPSCore::ShouldPlayCosmetics(const AActor *Actor)
+{
+	return Actor && Actor->GetNetMode() != NM_DedicatedServer;
+}
+#endif
+
+float FPSCore::PlayMontage(const USkeletalMeshComponent *Mesh, UAnimMontage *Montage)
+{
+	UAnimInstance *AnimInstance = Mesh ? Mesh->GetAnimInstance() : nullptr;
+	return AnimInstance ? AnimInstance->Montage_Play(Montage, 1.0f) : 0.0f;
+}
+
 void FFPSCoreModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -0,0 +1,176 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "FPSCoreReplicationGraph.h"
+#include "FPSCore.h"
+#include "FPSCharacter.h"
+#include "FPSCharacterController.h"
+#include "InteractionBase.h"
+#include "WeaponBase.h"
+#include "ReplicationGraphTypes.h"
+#include "Engine/LevelScriptActor.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("FPSCore Replication Graph"), STAT_FPSCoreReplicationGraph, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replication Graph Connections"), STAT_ReplicationGraphConnections, STATGROUP_FPSCore);
+
+void UFPSCoreReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// FPS Core's own actors
+	ClassRepNodePolicies.Set(AFPSCharacter::StaticClass(), EFPSCoreClassRepNodeMapping::Spatialize_Dynamic);
+	ClassRepNodePolicies.Set(AWeaponBase::StaticClass(), EFPSCoreClassRepNodeMapping::DependentOfOwner);
+	ClassRepNodePolicies.Set(AInteractionBase::StaticClass(), EFPSCoreClassRepNodeMapping::Spatialize_Dormancy);
+
+	// Player controllers only ever replicate to their own connection, through its always relevant node
+	ClassRepNodePolicies.Set(APlayerController::StaticClass(), EFPSCoreClassRepNodeMapping::NotRouted);
+	ClassRepNodePolicies.Set(AFPSCharacterController::StaticClass(), EFPSCoreClassRepNodeMapping::NotRouted);
+	ClassRepNodePolicies.Set(ALevelScriptActor::StaticClass(), EFPSCoreClassRepNodeMapping::NotRouted);
+
+	// Setting the cull distance and update rate of every replicated class from its defaults
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass *Class = *It;
+		const AActor *ActorCDO = Cast<AActor>(Class->GetDefaultObject(false));
+		if (!ActorCDO || !ActorCDO->GetIsReplicated())
+		{
+			continue;
+		}
+
+		// Skipping the temporary classes generated while compiling blueprints
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+		{
+			continue;
+		}
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.SetCullDistanceSquared(ActorCDO->NetCullDistanceSquared);
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->NetUpdateFrequency);
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void UFPSCoreReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = FVector2D(SpatialBiasX, SpatialBiasY);
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UFPSCoreReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection *ConnectionManager)
+{
+	Super::InitConnectionGraphNodes(ConnectionManager);
+
+	// Replicates the connection's own player controller and view target
+	UReplicationGraphNode_AlwaysRelevant_ForConnection *AlwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(AlwaysRelevantForConnectionNode, ConnectionManager);
+}
+
+EFPSCoreClassRepNodeMapping UFPSCoreReplicationGraph::GetMappingPolicy(const UClass *Class)
+{
+	if (const EFPSCoreClassRepNodeMapping *Policy = ClassRepNodePolicies.Get(Class))
+	{
+		return *Policy;
+	}
+
+	// Caching the policy of classes without one, so that it is only worked out once
+	const EFPSCoreClassRepNodeMapping Policy = GetDefaultMappingPolicy(GetDefault<AActor>(Class));
+	ClassRepNodePolicies.Set(Class, Policy);
+	return Policy;
+}
+
+EFPSCoreClassRepNodeMapping UFPSCoreReplicationGraph::GetDefaultMappingPolicy(const AActor *ActorCDO) const
+{
+	// Owner only actors are gathered by their connection's always relevant node
+	if (ActorCDO->bOnlyRelevantToOwner)
+	{
+		return EFPSCoreClassRepNodeMapping::NotRouted;
+	}
+
+	// Actors without a location (game state, player states and other infos) cannot be placed in the grid
+	const USceneComponent *RootComponent = ActorCDO->GetRootComponent();
+	if (ActorCDO->bAlwaysRelevant || !RootComponent)
+	{
+		return EFPSCoreClassRepNodeMapping::RelevantAllConnections;
+	}
+
+	return RootComponent->Mobility == EComponentMobility::Static ? EFPSCoreClassRepNodeMapping::Spatialize_Static : EFPSCoreClassRepNodeMapping::Spatialize_Dynamic;
+}
+
+void UFPSCoreReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo &ActorInfo, FGlobalActorReplicationInfo &GlobalInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case EFPSCoreClassRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Static:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::DependentOfOwner:
+		// Weapons are spawned with their owner, and never change owner while they exist. Dependents are replicated
+		// whenever their owner is, so the weapon's own NetCullDistanceSquared is not used by the graph
+		if (AActor *Owner = ActorInfo.Actor->GetOwner())
+		{
+			GlobalActorReplicationInfoMap.AddDependentActor(Owner, ActorInfo.Actor);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UFPSCoreReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo &ActorInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case EFPSCoreClassRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Static:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+
+	case EFPSCoreClassRepNodeMapping::DependentOfOwner:
+		if (AActor *Owner = ActorInfo.Actor->GetOwner())
+		{
+			GlobalActorReplicationInfoMap.RemoveDependentActor(Owner, ActorInfo.Actor);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+int32 UFPSCoreReplicationGraph::ServerReplicateActors(const float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FPSCoreReplicationGraph);
+	SET_DWORD_STAT(STAT_ReplicationGraphConnections, Connections.Num());
+
+	return Super::ServerReplicateActors(DeltaSeconds);
+}
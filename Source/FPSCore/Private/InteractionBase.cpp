@@ -8,4 +8,8 @@ AInteractionBase::AInteractionBase()
 {
 	MeshComp = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("MeshComp"));
 	RootComponent = MeshComp;
+
+	// Pickups placed in the map have nothing to replicate until they are interacted with, and are only considered by the
+	// replication graph again once woken up (see FlushNetDormancy in the Interact functions)
+	NetDormancy = DORM_Initial;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/ImpactAggregatorSubsystem.h"
+#include "FPSCore.h"
+#include "NiagaraComponent.h"
+#include "NiagaraSystem.h"
+#include "DataInterface/NiagaraDataInterfaceArrayFunctionLibrary.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Impact Aggregator Flush"), STAT_ImpactAggregatorFlush, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aggregated Impacts"), STAT_AggregatedImpacts, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact Batches"), STAT_ImpactBatches, STATGROUP_FPSCore);
+
+const FName UImpactAggregatorSubsystem::ImpactLocationsParameter(TEXT("ImpactLocations"));
+const FName UImpactAggregatorSubsystem::ImpactNormalsParameter(TEXT("ImpactNormals"));
+const FName UImpactAggregatorSubsystem::ImpactCountParameter(TEXT("ImpactCount"));
+
+bool UImpactAggregatorSubsystem::ShouldCreateSubsystem(UObject *Outer) const
+{
+	// Dedicated servers never play effects, so there is nothing to render
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UImpactAggregatorSubsystem::Prewarm(UNiagaraSystem *System)
+{
+	if (System)
+	{
+		FindOrAddBatch(System);
+	}
+}
+
+void UImpactAggregatorSubsystem::AddImpact(UNiagaraSystem *System, const FVector &Location, const FVector &Normal)
+{
+	FImpactBatch &Batch = FindOrAddBatch(System);
+	Batch.Locations.Add(Location);
+	Batch.Normals.Add(Normal);
+}
+
+FImpactBatch &UImpactAggregatorSubsystem::FindOrAddBatch(UNiagaraSystem *System)
+{
+	FImpactBatch &Batch = Batches.FindOrAdd(System);
+	if (!Batch.Component)
+	{
+		UWorld *World = GetWorld();
+
+		// A single component at the world origin, as impacts are fed to it in world space
+		Batch.Component = NewObject<UNiagaraComponent>(World);
+		Batch.Component->SetAutoActivate(false);
+		Batch.Component->SetAutoDestroy(false);
+		Batch.Component->SetAsset(System);
+		Batch.Component->RegisterComponentWithWorld(World);
+		Batch.Component->Activate(true);
+	}
+	return Batch;
+}
+
+void UImpactAggregatorSubsystem::FlushBatch(FImpactBatch &Batch)
+{
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(Batch.Component, ImpactLocationsParameter, Batch.Locations);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(Batch.Component, ImpactNormalsParameter, Batch.Normals);
+	Batch.Component->SetVariableInt(ImpactCountParameter, Batch.Locations.Num());
+
+	Batch.bHasPendingImpacts = Batch.Locations.Num() > 0;
+	Batch.Locations.Reset();
+	Batch.Normals.Reset();
+}
+
+void UImpactAggregatorSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_ImpactAggregatorFlush);
+
+	for (TPair<UNiagaraSystem *, FImpactBatch> &Pair : Batches)
+	{
+		FImpactBatch &Batch = Pair.Value;
+
+		// Batches without impacts this frame still need emptying once, so that last frame's impacts are not spawned again
+		if (Batch.Locations.Num() == 0 && !Batch.bHasPendingImpacts)
+		{
+			continue;
+		}
+
+		INC_DWORD_STAT_BY(STAT_AggregatedImpacts, Batch.Locations.Num());
+		INC_DWORD_STAT(STAT_ImpactBatches);
+
+		FlushBatch(Batch);
+	}
+}
+
+void UImpactAggregatorSubsystem::Deinitialize()
+{
+	for (TPair<UNiagaraSystem *, FImpactBatch> &Pair : Batches)
+	{
+		if (IsValid(Pair.Value.Component))
+		{
+			Pair.Value.Component->DestroyComponent();
+		}
+	}
+	Batches.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UImpactAggregatorSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UImpactAggregatorSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,208 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/LagCompensationSubsystem.h"
+#include "FPSCore.h"
+#include "FPSCharacter.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Record"), STAT_LagCompensationRecord, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Rewind"), STAT_LagCompensationRewind, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Restore"), STAT_LagCompensationRestore, STATGROUP_FPSCore);
+
+void ULagCompensationSubsystem::RegisterCharacter(AFPSCharacter *Character)
+{
+	if (!Character || Characters.Contains(Character))
+	{
+		return;
+	}
+
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(false);
+		Characters[Slot] = Character;
+	}
+	else
+	{
+		// Growing every history array by one block
+		Slot = Characters.Add(Character);
+		HeadIndices.Add(0);
+		SampleCounts.Add(0);
+		Timestamps.AddZeroed(HistoryLength);
+		Locations.AddZeroed(HistoryLength);
+		Rotations.AddZeroed(HistoryLength);
+	}
+
+	HeadIndices[Slot] = 0;
+	SampleCounts[Slot] = 0;
+}
+
+void ULagCompensationSubsystem::UnregisterCharacter(AFPSCharacter *Character)
+{
+	const int32 Slot = Characters.IndexOfByKey(Character);
+	if (Slot != INDEX_NONE)
+	{
+		Characters[Slot] = nullptr;
+		SampleCounts[Slot] = 0;
+		FreeSlots.Add(Slot);
+	}
+}
+
+double ULagCompensationSubsystem::ClampRewindTimestamp(const double Timestamp) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	return FMath::Clamp(Timestamp, Now - MaxRewindTime, Now);
+}
+
+double ULagCompensationSubsystem::SnapRewindTimestamp(const double Timestamp) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double TargetTime = ClampRewindTimestamp(Timestamp);
+
+	// Walking backwards from the newest snapshot, the distance to the target only shrinks until we pass it
+	double ClosestTime = Now;
+	double ClosestDistance = Now - TargetTime;
+	for (int32 Step = 0; Step < SnapshotCount; Step++)
+	{
+		const double SnapshotTime = SnapshotTimes[(SnapshotHead - Step + HistoryLength) % HistoryLength];
+		const double Distance = FMath::Abs(SnapshotTime - TargetTime);
+		if (Distance < ClosestDistance)
+		{
+			ClosestTime = SnapshotTime;
+			ClosestDistance = Distance;
+		}
+		if (SnapshotTime <= TargetTime)
+		{
+			break;
+		}
+	}
+	return ClosestTime;
+}
+
+void ULagCompensationSubsystem::RewindCharacters(const double Timestamp, const AFPSCharacter *IgnoredCharacter)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompensationRewind);
+
+	checkf(RewoundSlots.Num() == 0, TEXT("RewindCharacters called twice without RestoreCharacters"));
+
+	const double TargetTime = ClampRewindTimestamp(Timestamp);
+
+	for (int32 Slot = 0; Slot < Characters.Num(); Slot++)
+	{
+		const int32 Count = SampleCounts[Slot];
+		if (Count == 0)
+		{
+			continue;
+		}
+
+		AFPSCharacter *Character = Characters[Slot].Get();
+		if (!Character || Character == IgnoredCharacter)
+		{
+			continue;
+		}
+
+		// Walking backwards from the newest sample until we find the pair of samples surrounding our target time.
+		// We rarely rewind more than a handful of ticks, so this is cheaper than a binary search over the ring buffer
+		const int32 Base = Slot * HistoryLength;
+		int32 Newer = HeadIndices[Slot];
+		if (Timestamps[Base + Newer] <= TargetTime)
+		{
+			// The character has not been recorded since the target time, nothing to rewind
+			continue;
+		}
+
+		int32 Older = Newer;
+		for (int32 Step = 1; Step < Count; Step++)
+		{
+			Older = (Newer - 1 + HistoryLength) % HistoryLength;
+			if (Timestamps[Base + Older] <= TargetTime)
+			{
+				break;
+			}
+			Newer = Older;
+		}
+
+		const double OlderTime = Timestamps[Base + Older];
+		const double NewerTime = Timestamps[Base + Newer];
+		const float Alpha = NewerTime > OlderTime ? FMath::Clamp(static_cast<float>((TargetTime - OlderTime) / (NewerTime - OlderTime)), 0.0f, 1.0f) : 1.0f;
+
+		USkeletalMeshComponent *Hitboxes = Character->GetThirdPersonMesh();
+
+		RewoundSlots.Add(Slot);
+		SavedLocations.Add(Hitboxes->GetComponentLocation());
+		SavedRotations.Add(Hitboxes->GetComponentQuat());
+
+		const FVector RewoundLocation = FMath::Lerp(Locations[Base + Older], Locations[Base + Newer], Alpha);
+		const FQuat RewoundRotation = FQuat::Slerp(Rotations[Base + Older], Rotations[Base + Newer], Alpha);
+		Hitboxes->SetWorldLocationAndRotation(RewoundLocation, RewoundRotation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+}
+
+void ULagCompensationSubsystem::RestoreCharacters()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompensationRestore);
+
+	for (int32 Index = 0; Index < RewoundSlots.Num(); Index++)
+	{
+		if (AFPSCharacter *Character = Characters[RewoundSlots[Index]].Get())
+		{
+			Character->GetThirdPersonMesh()->SetWorldLocationAndRotation(SavedLocations[Index], SavedRotations[Index], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+
+	RewoundSlots.Reset();
+	SavedLocations.Reset();
+	SavedRotations.Reset();
+}
+
+void ULagCompensationSubsystem::RecordSnapshot()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompensationRecord);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	if (SnapshotTimes.Num() == 0)
+	{
+		SnapshotTimes.SetNumZeroed(HistoryLength);
+	}
+	SnapshotHead = SnapshotCount == 0 ? 0 : (SnapshotHead + 1) % HistoryLength;
+	SnapshotTimes[SnapshotHead] = Now;
+	SnapshotCount = FMath::Min(SnapshotCount + 1, HistoryLength);
+
+	for (int32 Slot = 0; Slot < Characters.Num(); Slot++)
+	{
+		const AFPSCharacter *Character = Characters[Slot].Get();
+		if (!Character)
+		{
+			continue;
+		}
+
+		const int32 Head = SampleCounts[Slot] == 0 ? 0 : (HeadIndices[Slot] + 1) % HistoryLength;
+		const int32 Index = Slot * HistoryLength + Head;
+		const USkeletalMeshComponent *Hitboxes = Character->GetThirdPersonMesh();
+
+		Timestamps[Index] = Now;
+		Locations[Index] = Hitboxes->GetComponentLocation();
+		Rotations[Index] = Hitboxes->GetComponentQuat();
+
+		HeadIndices[Slot] = Head;
+		SampleCounts[Slot] = FMath::Min(SampleCounts[Slot] + 1, HistoryLength);
+	}
+}
+
+void ULagCompensationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Only the server ever needs to rewind characters
+	if (GetWorld()->GetNetMode() != NM_Client)
+	{
+		RecordSnapshot();
+	}
+}
+
+TStatId ULagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULagCompensationSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,194 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/ProjectileSubsystem.h"
+#include "FPSCore.h"
+#include "WeaponBase.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Integrate"), STAT_ProjectileIntegrate, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Projectile Sweep"), STAT_ProjectileSweep, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Projectile Resolve"), STAT_ProjectileResolve, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Live Projectiles"), STAT_LiveProjectiles, STATGROUP_FPSCore);
+
+void UProjectileSubsystem::SpawnProjectile(AWeaponBase *Weapon, const FVector &Origin, const FVector &Velocity, const float GravityScale, const float Drag, const float Lifetime, const bool bAuthoritative)
+{
+	PositionsX.Add(Origin.X);
+	PositionsY.Add(Origin.Y);
+	PositionsZ.Add(Origin.Z);
+	PreviousX.Add(Origin.X);
+	PreviousY.Add(Origin.Y);
+	PreviousZ.Add(Origin.Z);
+	VelocitiesX.Add(Velocity.X);
+	VelocitiesY.Add(Velocity.Y);
+	VelocitiesZ.Add(Velocity.Z);
+	Gravities.Add(GetWorld()->GetGravityZ() * GravityScale);
+	Drags.Add(Drag);
+	RemainingLifetimes.Add(Lifetime);
+	Weapons.Add(Weapon);
+	Authoritative.Add(bAuthoritative);
+	SweepResults.AddDefaulted();
+	SweepHits.Add(false);
+}
+
+void UProjectileSubsystem::Integrate(const float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileIntegrate);
+
+	const int32 Num = PositionsX.Num();
+	int32 Index = 0;
+
+	// Semi-implicit Euler, four projectiles at a time
+	const VectorRegister4Float Step = VectorSetFloat1(DeltaTime);
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float Zero = VectorZeroFloat();
+
+	for (; Index + 4 <= Num; Index += 4)
+	{
+		const VectorRegister4Float Damping = VectorMax(VectorSubtract(One, VectorMultiply(VectorLoad(&Drags[Index]), Step)), Zero);
+
+		const VectorRegister4Float VelocityX = VectorMultiply(VectorLoad(&VelocitiesX[Index]), Damping);
+		const VectorRegister4Float VelocityY = VectorMultiply(VectorLoad(&VelocitiesY[Index]), Damping);
+		const VectorRegister4Float VelocityZ = VectorMultiplyAdd(VectorLoad(&Gravities[Index]), Step, VectorMultiply(VectorLoad(&VelocitiesZ[Index]), Damping));
+
+		const VectorRegister4Float PositionX = VectorLoad(&PositionsX[Index]);
+		const VectorRegister4Float PositionY = VectorLoad(&PositionsY[Index]);
+		const VectorRegister4Float PositionZ = VectorLoad(&PositionsZ[Index]);
+
+		VectorStore(PositionX, &PreviousX[Index]);
+		VectorStore(PositionY, &PreviousY[Index]);
+		VectorStore(PositionZ, &PreviousZ[Index]);
+
+		VectorStore(VectorMultiplyAdd(VelocityX, Step, PositionX), &PositionsX[Index]);
+		VectorStore(VectorMultiplyAdd(VelocityY, Step, PositionY), &PositionsY[Index]);
+		VectorStore(VectorMultiplyAdd(VelocityZ, Step, PositionZ), &PositionsZ[Index]);
+
+		VectorStore(VelocityX, &VelocitiesX[Index]);
+		VectorStore(VelocityY, &VelocitiesY[Index]);
+		VectorStore(VelocityZ, &VelocitiesZ[Index]);
+
+		VectorStore(VectorSubtract(VectorLoad(&RemainingLifetimes[Index]), Step), &RemainingLifetimes[Index]);
+	}
+
+	// The remaining (up to three) projectiles
+	for (; Index < Num; Index++)
+	{
+		const float Damping = FMath::Max(1.0f - Drags[Index] * DeltaTime, 0.0f);
+
+		VelocitiesX[Index] *= Damping;
+		VelocitiesY[Index] *= Damping;
+		VelocitiesZ[Index] = VelocitiesZ[Index] * Damping + Gravities[Index] * DeltaTime;
+
+		PreviousX[Index] = PositionsX[Index];
+		PreviousY[Index] = PositionsY[Index];
+		PreviousZ[Index] = PositionsZ[Index];
+
+		PositionsX[Index] += VelocitiesX[Index] * DeltaTime;
+		PositionsY[Index] += VelocitiesY[Index] * DeltaTime;
+		PositionsZ[Index] += VelocitiesZ[Index] * DeltaTime;
+
+		RemainingLifetimes[Index] -= DeltaTime;
+	}
+}
+
+void UProjectileSubsystem::Sweep()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileSweep);
+
+	const UWorld *World = GetWorld();
+
+	// Resolving the actors to ignore on the game thread, as weak pointers should not be dereferenced by workers
+	TArray<const AActor *, TInlineAllocator<64>> IgnoredWeapons;
+	IgnoredWeapons.SetNumUninitialized(Weapons.Num());
+	for (int32 Index = 0; Index < Weapons.Num(); Index++)
+	{
+		IgnoredWeapons[Index] = Weapons[Index].Get();
+	}
+
+	// Scene queries only read from the physics scene, so every segment can be swept in parallel
+	ParallelFor(PositionsX.Num(), [this, World, &IgnoredWeapons](const int32 Index)
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ProjectileSweep), true);
+		QueryParams.bReturnPhysicalMaterial = true;
+		if (const AActor *Weapon = IgnoredWeapons[Index])
+		{
+			QueryParams.AddIgnoredActor(Weapon);
+			QueryParams.AddIgnoredActor(Weapon->GetOwner());
+		}
+
+		const FVector Start(PreviousX[Index], PreviousY[Index], PreviousZ[Index]);
+		const FVector End(PositionsX[Index], PositionsY[Index], PositionsZ[Index]);
+		SweepHits[Index] = World->LineTraceSingleByChannel(SweepResults[Index], Start, End, ECC_GameTraceChannel1, QueryParams);
+	});
+}
+
+void UProjectileSubsystem::Resolve()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileResolve);
+
+	// Handling hits in index order, so that the outcome does not depend on how the sweeps were scheduled
+	TArray<int32, TInlineAllocator<64>> ExpiredProjectiles;
+	for (int32 Index = 0; Index < PositionsX.Num(); Index++)
+	{
+		if (SweepHits[Index])
+		{
+			if (AWeaponBase *Weapon = Weapons[Index].Get())
+			{
+				const FVector Direction = FVector(VelocitiesX[Index], VelocitiesY[Index], VelocitiesZ[Index]).GetSafeNormal();
+				Weapon->OnProjectileHit(SweepResults[Index], Direction, Authoritative[Index]);
+			}
+			ExpiredProjectiles.Add(Index);
+		}
+		else if (RemainingLifetimes[Index] <= 0.0f)
+		{
+			ExpiredProjectiles.Add(Index);
+		}
+	}
+
+	// Removing from the back, so that swapping never moves a projectile that still has to be removed
+	for (int32 Index = ExpiredProjectiles.Num() - 1; Index >= 0; Index--)
+	{
+		RemoveProjectile(ExpiredProjectiles[Index]);
+	}
+}
+
+void UProjectileSubsystem::RemoveProjectile(const int32 Index)
+{
+	PositionsX.RemoveAtSwap(Index, 1, false);
+	PositionsY.RemoveAtSwap(Index, 1, false);
+	PositionsZ.RemoveAtSwap(Index, 1, false);
+	PreviousX.RemoveAtSwap(Index, 1, false);
+	PreviousY.RemoveAtSwap(Index, 1, false);
+	PreviousZ.RemoveAtSwap(Index, 1, false);
+	VelocitiesX.RemoveAtSwap(Index, 1, false);
+	VelocitiesY.RemoveAtSwap(Index, 1, false);
+	VelocitiesZ.RemoveAtSwap(Index, 1, false);
+	Gravities.RemoveAtSwap(Index, 1, false);
+	Drags.RemoveAtSwap(Index, 1, false);
+	RemainingLifetimes.RemoveAtSwap(Index, 1, false);
+	Weapons.RemoveAtSwap(Index, 1, false);
+	Authoritative.RemoveAtSwap(Index, 1, false);
+	SweepResults.RemoveAtSwap(Index, 1, false);
+	SweepHits.RemoveAtSwap(Index, 1, false);
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SET_DWORD_STAT(STAT_LiveProjectiles, PositionsX.Num());
+
+	if (PositionsX.Num() == 0)
+	{
+		return;
+	}
+
+	Integrate(DeltaTime);
+	Sweep();
+	Resolve();
+}
+
+TStatId UProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,199 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/ShotResolverSubsystem.h"
+#include "FPSCore.h"
+#include "Subsystems/LagCompensationSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Shot Resolver Trace"), STAT_ShotResolverTrace, STATGROUP_FPSCore);
+DECLARE_CYCLE_STAT(TEXT("Shot Resolver Apply"), STAT_ShotResolverApply, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resolved Shots"), STAT_ResolvedShots, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resolved Pellets"), STAT_ResolvedPellets, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shot Resolver Rewinds"), STAT_ShotResolverRewinds, STATGROUP_FPSCore);
+
+static TAutoConsoleVariable<bool> CVarSnapShotRewinds(
+	TEXT("FPSCore.SnapShotRewinds"),
+	true,
+	TEXT("Whether shots are rewound to the lag compensation snapshot closest to their time, so that shots fired close together share a rewind. Snapped hitboxes may be off by up to half a snapshot interval; when disabled, every shot is rewound to its own interpolated time."),
+	ECVF_Default);
+
+void UShotResolverSubsystem::QueueShot(AWeaponBase *Weapon, const FVector &CameraLocation, const FRotator &CameraRotation, const double RewindTime)
+{
+	FQueuedShot &Shot = QueuedShots.AddDefaulted_GetRef();
+	Shot.Weapon = Weapon;
+	Shot.RewindTime = RewindTime;
+	Shot.FirstTrace = TraceStarts.Num();
+	Shot.NumTraces = Weapon->GetNumPellets();
+
+	Weapon->PrepareShot(CameraLocation, CameraRotation, Shot.ImpactBatch);
+
+	const FVector Origin = Shot.ImpactBatch.Origin;
+	const float Range = Weapon->GetShotRange();
+
+	for (int32 Pellet = 0; Pellet < Shot.NumTraces; Pellet++)
+	{
+		TraceStarts.Add(Origin);
+		TraceEnds.Add(Origin + Weapon->GetPelletRotation(Shot.ImpactBatch, Pellet).Vector() * Range);
+	}
+}
+
+void UShotResolverSubsystem::TraceShots(const TConstArrayView<int32> ShotIndices)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShotResolverTrace);
+
+	UWorld *World = GetWorld();
+
+	// Every shot of the group shares the same rewind time, so other players only need to be moved once, and not at all
+	// when the shots were fired at the present pose (the listen server's own player, or snapped to it)
+	const double RewindTime = QueuedShots[ShotIndices[0]].RewindTime;
+	ULagCompensationSubsystem *LagCompensation = World->GetSubsystem<ULagCompensationSubsystem>();
+	if (LagCompensation && RewindTime < World->GetTimeSeconds())
+	{
+		// The shooters are rewound as well, but they are ignored by their own traces
+		INC_DWORD_STAT(STAT_ShotResolverRewinds);
+		LagCompensation->RewindCharacters(RewindTime, nullptr);
+	}
+	else
+	{
+		LagCompensation = nullptr;
+	}
+
+	// Flattening the pellets of the group, and resolving the actors to ignore on the game thread
+	TArray<int32, TInlineAllocator<64>> Traces;
+	TArray<const AActor *, TInlineAllocator<64>> IgnoredWeapons;
+	for (const int32 ShotIndex : ShotIndices)
+	{
+		const FQueuedShot &Shot = QueuedShots[ShotIndex];
+		const AWeaponBase *Weapon = Shot.Weapon.Get();
+		if (!Weapon)
+		{
+			continue;
+		}
+
+		for (int32 Pellet = 0; Pellet < Shot.NumTraces; Pellet++)
+		{
+			Traces.Add(Shot.FirstTrace + Pellet);
+			IgnoredWeapons.Add(Weapon);
+		}
+	}
+
+	// Scene queries only read from the physics scene, so every pellet can be traced in parallel
+	ParallelFor(Traces.Num(), [this, World, &Traces, &IgnoredWeapons](const int32 Index)
+	{
+		const int32 Trace = Traces[Index];
+		const AActor *Weapon = IgnoredWeapons[Index];
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShotResolverTrace), true);
+		QueryParams.bReturnPhysicalMaterial = true;
+		QueryParams.AddIgnoredActor(Weapon);
+		QueryParams.AddIgnoredActor(Weapon->GetOwner());
+
+		TraceHits[Trace] = World->LineTraceSingleByChannel(TraceResults[Trace], TraceStarts[Trace], TraceEnds[Trace], ECC_GameTraceChannel1, QueryParams);
+	});
+
+	if (LagCompensation)
+	{
+		LagCompensation->RestoreCharacters();
+	}
+}
+
+void UShotResolverSubsystem::ApplyShots()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShotResolverApply);
+
+	for (FQueuedShot &Shot : QueuedShots)
+	{
+		AWeaponBase *Weapon = Shot.Weapon.Get();
+		if (!Weapon)
+		{
+			continue;
+		}
+
+		for (int32 Pellet = 0; Pellet < Shot.NumTraces; Pellet++)
+		{
+			const int32 Trace = Shot.FirstTrace + Pellet;
+			if (!TraceHits[Trace])
+			{
+				continue;
+			}
+
+			const FHitResult &Hit = TraceResults[Trace];
+			Weapon->ApplyHitDamage(Hit, (TraceEnds[Trace] - TraceStarts[Trace]).GetSafeNormal());
+
+			FWeaponImpact &Impact = Shot.ImpactBatch.Impacts.AddDefaulted_GetRef();
+			Impact.PelletIndex = static_cast<uint8>(Pellet);
+			Impact.Distance = Hit.Distance;
+			Impact.HitComponent = Hit.GetComponent();
+			Impact.SurfaceResponse = static_cast<uint8>(Weapon->GetSurfaceResponseIndex(Hit.PhysMaterial.Get()));
+		}
+
+		// Sending every pellet to our clients at once
+		Weapon->Multi_Fire(Shot.ImpactBatch);
+	}
+}
+
+void UShotResolverSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (QueuedShots.Num() == 0)
+	{
+		return;
+	}
+
+	SET_DWORD_STAT(STAT_ResolvedShots, QueuedShots.Num());
+	SET_DWORD_STAT(STAT_ResolvedPellets, TraceStarts.Num());
+
+	TraceResults.SetNum(TraceStarts.Num());
+	TraceHits.SetNumZeroed(TraceStarts.Num());
+
+	// Snapping every shot to the snapshot closest to its rewind time, trading the interpolation between snapshots for
+	// shared rewinds. Shots which are not snapped only share a rewind with shots fired at exactly the same time
+	const ULagCompensationSubsystem *LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>();
+	if (LagCompensation && CVarSnapShotRewinds.GetValueOnGameThread())
+	{
+		for (FQueuedShot &Shot : QueuedShots)
+		{
+			Shot.RewindTime = LagCompensation->SnapRewindTimestamp(Shot.RewindTime);
+		}
+	}
+
+	// Grouping shots that share a rewind time, keeping the order in which they were queued within each group
+	TArray<int32, TInlineAllocator<64>> ShotOrder;
+	ShotOrder.SetNumUninitialized(QueuedShots.Num());
+	for (int32 Index = 0; Index < ShotOrder.Num(); Index++)
+	{
+		ShotOrder[Index] = Index;
+	}
+	ShotOrder.StableSort([this](const int32 A, const int32 B)
+	{
+		return QueuedShots[A].RewindTime < QueuedShots[B].RewindTime;
+	});
+
+	for (int32 GroupStart = 0; GroupStart < ShotOrder.Num();)
+	{
+		int32 GroupEnd = GroupStart + 1;
+		while (GroupEnd < ShotOrder.Num() && QueuedShots[ShotOrder[GroupEnd]].RewindTime == QueuedShots[ShotOrder[GroupStart]].RewindTime)
+		{
+			GroupEnd++;
+		}
+
+		TraceShots(MakeArrayView(&ShotOrder[GroupStart], GroupEnd - GroupStart));
+		GroupStart = GroupEnd;
+	}
+
+	ApplyShots();
+
+	QueuedShots.Reset();
+	TraceStarts.Reset();
+	TraceEnds.Reset();
+	TraceResults.Reset();
+	TraceHits.Reset();
+}
+
+TStatId UShotResolverSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShotResolverSubsystem, STATGROUP_Tickables);
+}
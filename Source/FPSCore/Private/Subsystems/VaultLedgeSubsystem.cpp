@@ -0,0 +1,54 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/VaultLedgeSubsystem.h"
+#include "FPSCore.h"
+#include "VaultLedges.h"
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Baked Vault Lookups"), STAT_BakedVaultLookups, STATGROUP_FPSCore);
+
+static TAutoConsoleVariable<bool> CVarUseBakedVaultLedges(
+	TEXT("FPSCore.UseBakedVaultLedges"),
+	true,
+	TEXT("Whether characters look up baked ledges to vault to, rather than tracing for them, where ledges have been baked."),
+	ECVF_Default);
+
+EVaultLedgeLookup UVaultLedgeSubsystem::FindLedge(const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, FVaultLedge &OutLedge) const
+{
+	if (!LedgeData || !CVarUseBakedVaultLedges.GetValueOnGameThread() || !LedgeData->IsBaked(Location) || !LedgeData->GetSettings().Matches(Settings))
+	{
+		return EVaultLedgeLookup::Unbaked;
+	}
+
+	INC_DWORD_STAT(STAT_BakedVaultLookups);
+
+	const FVaultLedge *Ledge = LedgeData->FindLedge(Location, Forward);
+	if (!Ledge)
+	{
+		return EVaultLedgeLookup::NoLedge;
+	}
+
+	OutLedge = *Ledge;
+	return EVaultLedgeLookup::Found;
+}
+
+void UVaultLedgeSubsystem::OnWorldBeginPlay(UWorld &InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Play in editor worlds are duplicates of the map, with a prefixed name
+	const FString MapPackageName = UWorld::RemovePIEPrefix(InWorld.GetOutermost()->GetName());
+	const FString LedgePackageName = UVaultLedgeData::GetPackageNameForMap(MapPackageName);
+	if (!FPackageName::DoesPackageExist(LedgePackageName))
+	{
+		return;
+	}
+
+	const FString ObjectPath = LedgePackageName + TEXT(".") + FPackageName::GetShortName(LedgePackageName);
+	LedgeData = LoadObject<UVaultLedgeData>(nullptr, *ObjectPath);
+	if (LedgeData)
+	{
+		UE_LOG(LogProfilingDebugging, Log, TEXT("Loaded %d baked vault ledges for %s"), LedgeData->GetNumLedges(), *MapPackageName);
+	}
+}
@@ -0,0 +1,191 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/WeaponAudioSubsystem.h"
+#include "FPSCore.h"
+#include "WeaponBase.h"
+#include "Components/AudioComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundBase.h"
+#include "Sound/SoundConcurrency.h"
+#include "Engine/World.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Sounds Played"), STAT_WeaponSoundsPlayed, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Sounds Culled"), STAT_WeaponSoundsCulled, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Fire Loops"), STAT_WeaponFireLoops, STATGROUP_FPSCore);
+
+static TAutoConsoleVariable<int32> CVarWeaponSoundVoicesPerClass(
+	TEXT("FPSCore.WeaponSoundVoicesPerClass"),
+	8,
+	TEXT("The amount of voices shared by every instance of a weapon class without its own SoundConcurrency. Read when a class first plays a sound."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarWeaponFireLoopRateOfFire(
+	TEXT("FPSCore.WeaponFireLoopRateOfFire"),
+	600.0f,
+	TEXT("The rate of fire (in RPM) from which automatic weapons with a FireLoopSound play it instead of one sound per shot."),
+	ECVF_Scalability);
+
+/** The amount of shot intervals without a shot after which a fire loop stops on its own */
+static constexpr double FireLoopTimeoutShots = 2.0;
+
+bool UWeaponAudioSubsystem::ShouldCreateSubsystem(UObject *Outer) const
+{
+	// Dedicated servers never play sounds
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+USoundConcurrency *UWeaponAudioSubsystem::GetConcurrency(AWeaponBase *Weapon)
+{
+	if (USoundConcurrency *WeaponConcurrency = Weapon->GetStaticWeaponData()->SoundConcurrency)
+	{
+		return WeaponConcurrency;
+	}
+
+	// Concurrency groups are per settings object, so one object per class limits every instance of the class together
+	USoundConcurrency *&Concurrency = ClassConcurrency.FindOrAdd(Weapon->GetClass());
+	if (!Concurrency)
+	{
+		Concurrency = NewObject<USoundConcurrency>(this);
+		Concurrency->Concurrency.MaxCount = FMath::Max(CVarWeaponSoundVoicesPerClass.GetValueOnGameThread(), 1);
+		Concurrency->Concurrency.ResolutionRule = EMaxConcurrentResolutionRule::StopFarthestThenOldest;
+		Concurrency->Concurrency.bLimitToOwner = false;
+	}
+	return Concurrency;
+}
+
+bool UWeaponAudioSubsystem::IsAudible(const USoundBase *Sound, const FVector &Location) const
+{
+	return UGameplayStatics::AreAnyListenersWithinRange(GetWorld(), Location, Sound->GetMaxDistance());
+}
+
+void UWeaponAudioSubsystem::PlayWeaponSound(AWeaponBase *Weapon, USoundBase *Sound, const FVector &Location)
+{
+	if (!Sound)
+	{
+		return;
+	}
+
+	if (!IsAudible(Sound, Location))
+	{
+		INC_DWORD_STAT(STAT_WeaponSoundsCulled);
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_WeaponSoundsPlayed);
+	UGameplayStatics::PlaySoundAtLocation(GetWorld(), Sound, Location, FRotator::ZeroRotator, 1.0f, 1.0f, 0.0f, nullptr, GetConcurrency(Weapon), Weapon);
+}
+
+void UWeaponAudioSubsystem::PlayFireSound(AWeaponBase *Weapon, USceneComponent *SoundComponent, const FName SocketName)
+{
+	const FStaticWeaponData &WeaponData = *Weapon->GetStaticWeaponData();
+	const FVector Location = SoundComponent->GetSocketLocation(SocketName);
+
+	// Silenced weapons and slower weapons play one sound per shot, as do weapons without a valid rate of fire to time the loop with
+	const bool bUseFireLoop = WeaponData.FireLoopSound.Get() && WeaponData.bAutomaticFire && !WeaponData.bSilenced && WeaponData.RateOfFire > 0.0f && WeaponData.RateOfFire >= CVarWeaponFireLoopRateOfFire.GetValueOnGameThread();
+	if (!bUseFireLoop)
+	{
+		PlayWeaponSound(Weapon, WeaponData.bSilenced ? WeaponData.SilencedSound.Get() : WeaponData.FireSound.Get(), Location);
+		return;
+	}
+
+	FWeaponFireLoop &Loop = FireLoops.FindOrAdd(Weapon);
+	Loop.LastShotTime = GetWorld()->GetTimeSeconds();
+	Loop.ShotInterval = 60.0 / WeaponData.RateOfFire;
+	Loop.TailSound = WeaponData.FireTailSound.Get();
+	Loop.Concurrency = GetConcurrency(Weapon);
+
+	// Shots of a burst which is already playing only keep the loop alive
+	if (Loop.AudioComponent && Loop.AudioComponent->IsPlaying())
+	{
+		return;
+	}
+
+	if (!IsAudible(WeaponData.FireLoopSound.Get(), Location))
+	{
+		INC_DWORD_STAT(STAT_WeaponSoundsCulled);
+		return;
+	}
+
+	// The loop starts mid-cycle, so the attack of the first shot comes from the start sound
+	PlayWeaponSound(Weapon, WeaponData.FireStartSound.Get(), Location);
+
+	INC_DWORD_STAT(STAT_WeaponSoundsPlayed);
+	if (Loop.AudioComponent && Loop.AudioComponent->GetAttachParent() == SoundComponent)
+	{
+		Loop.AudioComponent->Play();
+	}
+	else
+	{
+		if (Loop.AudioComponent)
+		{
+			Loop.AudioComponent->DestroyComponent();
+		}
+		Loop.AudioComponent = UGameplayStatics::SpawnSoundAttached(WeaponData.FireLoopSound.Get(), SoundComponent, SocketName, FVector::ZeroVector, EAttachLocation::SnapToTarget, true, 1.0f, 1.0f, 0.0f, nullptr, Loop.Concurrency, false);
+	}
+}
+
+void UWeaponAudioSubsystem::StopFireLoop(AWeaponBase *Weapon)
+{
+	if (FWeaponFireLoop *Loop = FireLoops.Find(Weapon))
+	{
+		StopLoop(*Loop);
+	}
+}
+
+void UWeaponAudioSubsystem::StopLoop(FWeaponFireLoop &Loop)
+{
+	if (!Loop.AudioComponent || !Loop.AudioComponent->IsPlaying())
+	{
+		return;
+	}
+
+	Loop.AudioComponent->Stop();
+
+	const FVector Location = Loop.AudioComponent->GetComponentLocation();
+	if (Loop.TailSound && IsAudible(Loop.TailSound, Location))
+	{
+		INC_DWORD_STAT(STAT_WeaponSoundsPlayed);
+		UGameplayStatics::PlaySoundAtLocation(GetWorld(), Loop.TailSound, Location, FRotator::ZeroRotator, 1.0f, 1.0f, 0.0f, nullptr, Loop.Concurrency, Loop.AudioComponent->GetOwner());
+	}
+}
+
+void UWeaponAudioSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	int32 PlayingLoops = 0;
+
+	for (auto Iterator = FireLoops.CreateIterator(); Iterator; ++Iterator)
+	{
+		FWeaponFireLoop &Loop = Iterator.Value();
+
+		// Forgetting weapons which no longer exist, whose components have been destroyed along with them
+		if (!Iterator.Key().IsValid() || !IsValid(Loop.AudioComponent))
+		{
+			Iterator.RemoveCurrent();
+			continue;
+		}
+
+		if (!Loop.AudioComponent->IsPlaying())
+		{
+			continue;
+		}
+
+		// Stopping loops once shots stop arriving, as remote clients are never told that a weapon stopped firing
+		if (Now - Loop.LastShotTime > Loop.ShotInterval * FireLoopTimeoutShots)
+		{
+			StopLoop(Loop);
+			continue;
+		}
+
+		PlayingLoops++;
+	}
+
+	SET_DWORD_STAT(STAT_WeaponFireLoops, PlayingLoops);
+}
+
+TStatId UWeaponAudioSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UWeaponAudioSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,167 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/WeaponEffectPoolSubsystem.h"
+#include "FPSCore.h"
+#include "NiagaraComponent.h"
+#include "NiagaraSystem.h"
+#include "Engine/World.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effect Pool Hits"), STAT_EffectPoolHits, STATGROUP_FPSCore);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effect Pool Misses"), STAT_EffectPoolMisses, STATGROUP_FPSCore);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effect Pool Active"), STAT_EffectPoolActive, STATGROUP_FPSCore);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effect Pool Peak"), STAT_EffectPoolPeak, STATGROUP_FPSCore);
+
+bool UWeaponEffectPoolSubsystem::ShouldCreateSubsystem(UObject *Outer) const
+{
+	// Dedicated servers never play effects, so there is nothing to pool
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UWeaponEffectPoolSubsystem::Prewarm(UNiagaraSystem *System, const int32 Count)
+{
+	if (!System)
+	{
+		return;
+	}
+
+	FWeaponEffectPool &Pool = Pools.FindOrAdd(System);
+	while (Pool.NumComponents < Count)
+	{
+		UNiagaraComponent *Component = CreateComponent(System);
+
+		// Activating the system once, so that its instance is initialised now rather than on the first shot
+		Component->Activate(true);
+		Component->DeactivateImmediate();
+
+		Pool.FreeComponents.Add(Component);
+	}
+}
+
+UNiagaraComponent *UWeaponEffectPoolSubsystem::SpawnEffectAtLocation(UNiagaraSystem *System, const FVector &Location, const FRotator &Rotation)
+{
+	if (!System)
+	{
+		return nullptr;
+	}
+
+	UNiagaraComponent *Component = AcquireComponent(System);
+	Component->SetWorldLocationAndRotation(Location, Rotation);
+	Component->Activate(true);
+	return Component;
+}
+
+UNiagaraComponent *UWeaponEffectPoolSubsystem::SpawnEffectAttached(UNiagaraSystem *System, USceneComponent *AttachToComponent, const FName AttachPointName, const FVector &Location, const FRotator &Rotation, const EAttachLocation::Type LocationType)
+{
+	if (!System)
+	{
+		return nullptr;
+	}
+
+	if (!AttachToComponent)
+	{
+		return SpawnEffectAtLocation(System, Location, Rotation);
+	}
+
+	UNiagaraComponent *Component = AcquireComponent(System);
+	if (LocationType == EAttachLocation::KeepWorldPosition)
+	{
+		Component->AttachToComponent(AttachToComponent, FAttachmentTransformRules::KeepWorldTransform, AttachPointName);
+		Component->SetWorldLocationAndRotation(Location, Rotation);
+	}
+	else
+	{
+		Component->AttachToComponent(AttachToComponent, FAttachmentTransformRules::SnapToTargetNotIncludingScale, AttachPointName);
+		Component->SetRelativeLocationAndRotation(Location, Rotation);
+	}
+	Component->Activate(true);
+	return Component;
+}
+
+UNiagaraComponent *UWeaponEffectPoolSubsystem::AcquireComponent(UNiagaraSystem *System)
+{
+	FWeaponEffectPool &Pool = Pools.FindOrAdd(System);
+
+	UNiagaraComponent *Component = nullptr;
+	if (Pool.FreeComponents.Num() > 0)
+	{
+		Component = Pool.FreeComponents.Pop(false);
+		Stats.Hits++;
+	}
+	else
+	{
+		Component = CreateComponent(System);
+		Stats.Misses++;
+	}
+
+	ActiveComponents.Add(Component);
+	Stats.Active = ActiveComponents.Num();
+	Stats.Peak = FMath::Max(Stats.Peak, Stats.Active);
+
+	SET_DWORD_STAT(STAT_EffectPoolHits, Stats.Hits);
+	SET_DWORD_STAT(STAT_EffectPoolMisses, Stats.Misses);
+	SET_DWORD_STAT(STAT_EffectPoolActive, Stats.Active);
+	SET_DWORD_STAT(STAT_EffectPoolPeak, Stats.Peak);
+
+	return Component;
+}
+
+UNiagaraComponent *UWeaponEffectPoolSubsystem::CreateComponent(UNiagaraSystem *System)
+{
+	UWorld *World = GetWorld();
+
+	// Owned by the world rather than by a weapon, so that effects outlive the weapon (and the actor) they were played on
+	UNiagaraComponent *Component = NewObject<UNiagaraComponent>(World);
+	Component->SetAutoActivate(false);
+	Component->SetAutoDestroy(false);
+	Component->SetAsset(System);
+	Component->OnSystemFinished.AddDynamic(this, &UWeaponEffectPoolSubsystem::OnEffectFinished);
+	Component->RegisterComponentWithWorld(World);
+
+	Pools.FindOrAdd(System).NumComponents++;
+	Stats.Pooled++;
+
+	return Component;
+}
+
+void UWeaponEffectPoolSubsystem::OnEffectFinished(UNiagaraComponent *Component)
+{
+	// Components finishing while being prewarmed are already in the pool
+	if (ActiveComponents.Remove(Component) == 0)
+	{
+		return;
+	}
+
+	Component->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	Pools.FindOrAdd(Component->GetAsset()).FreeComponents.Add(Component);
+
+	Stats.Active = ActiveComponents.Num();
+	SET_DWORD_STAT(STAT_EffectPoolActive, Stats.Active);
+}
+
+void UWeaponEffectPoolSubsystem::Deinitialize()
+{
+	UE_LOG(LogProfilingDebugging, Log, TEXT("Weapon effect pool: %d hits, %d misses, %d peak active, %d pooled"), Stats.Hits, Stats.Misses, Stats.Peak, Stats.Pooled);
+
+	for (TPair<UNiagaraSystem *, FWeaponEffectPool> &Pool : Pools)
+	{
+		for (UNiagaraComponent *Component : Pool.Value.FreeComponents)
+		{
+			if (IsValid(Component))
+			{
+				Component->DestroyComponent();
+			}
+		}
+	}
+	for (UNiagaraComponent *Component : ActiveComponents)
+	{
+		if (IsValid(Component))
+		{
+			Component->DestroyComponent();
+		}
+	}
+
+	Pools.Empty();
+	ActiveComponents.Empty();
+
+	Super::Deinitialize();
+}
@@ -0,0 +1,179 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Subsystems/WeaponSignificanceSubsystem.h"
+#include "FPSCore.h"
+#include "WeaponBase.h"
+#include "SignificanceManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Effect Budget"), STAT_WeaponEffectBudget, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Effects Played"), STAT_WeaponEffectsPlayed, STATGROUP_FPSCore);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Effects Dropped"), STAT_WeaponEffectsDropped, STATGROUP_FPSCore);
+
+static TAutoConsoleVariable<int32> CVarWeaponEffectBudget(
+	TEXT("FPSCore.WeaponEffectBudget"),
+	96,
+	TEXT("The amount of muzzle flashes, tracers and casings that weapons may play per frame. 0 disables the budget."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarWeaponSignificanceDistance(
+	TEXT("FPSCore.WeaponSignificanceDistance"),
+	10000.0f,
+	TEXT("The distance (in cm) from the closest viewpoint at which weapons become insignificant."),
+	ECVF_Scalability);
+
+namespace WeaponSignificance
+{
+	/** The significance multiplier of weapons which have not been rendered recently */
+	constexpr float OffScreenScale = 0.25f;
+
+	/** The significance multiplier of weapons held by a friendly team */
+	constexpr float FriendlyScale = 0.5f;
+
+	/** The significance below which multi-pellet shots only play a single tracer */
+	constexpr float SimplifyThreshold = 0.5f;
+
+	/** How long ago, in seconds, a weapon may have been rendered and still be considered on screen */
+	constexpr float RenderTolerance = 0.2f;
+
+	/** How much of the budget every type of effect may use, casings being the first to go */
+	float GetCosmeticWeight(const EWeaponCosmetic Cosmetic)
+	{
+		switch (Cosmetic)
+		{
+		case EWeaponCosmetic::MuzzleFlash:
+			return 1.0f;
+		case EWeaponCosmetic::Tracer:
+			return 0.75f;
+		default:
+			return 0.5f;
+		}
+	}
+}
+
+const FName UWeaponSignificanceSubsystem::SignificanceTag(TEXT("FPSCoreWeapon"));
+
+bool UWeaponSignificanceSubsystem::ShouldCreateSubsystem(UObject *Outer) const
+{
+	// Dedicated servers never play effects, so there is nothing to budget
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UWeaponSignificanceSubsystem::RegisterWeapon(AWeaponBase *Weapon)
+{
+	if (USignificanceManager *SignificanceManager = USignificanceManager::Get(GetWorld()))
+	{
+		SignificanceManager->RegisterObject(Weapon, SignificanceTag, [this](USignificanceManager::FManagedObjectInfo *ObjectInfo, const FTransform &Viewpoint)
+		{
+			return CalculateSignificance(CastChecked<AWeaponBase>(ObjectInfo->GetObject()), Viewpoint);
+		});
+	}
+}
+
+void UWeaponSignificanceSubsystem::UnregisterWeapon(AWeaponBase *Weapon)
+{
+	if (USignificanceManager *SignificanceManager = USignificanceManager::Get(GetWorld()))
+	{
+		SignificanceManager->UnregisterObject(Weapon);
+	}
+}
+
+float UWeaponSignificanceSubsystem::GetWeaponSignificance(const AWeaponBase *Weapon) const
+{
+	// Without a significance manager every weapon is treated as fully significant
+	const USignificanceManager *SignificanceManager = USignificanceManager::Get(GetWorld());
+	return SignificanceManager ? SignificanceManager->GetSignificance(Weapon) : 1.0f;
+}
+
+float UWeaponSignificanceSubsystem::CalculateSignificance(const AWeaponBase *Weapon, const FTransform &Viewpoint) const
+{
+	// Local players always see their own effects
+	const APawn *OwnerPawn = Cast<APawn>(Weapon->GetOwner());
+	if (OwnerPawn && OwnerPawn->IsLocallyControlled())
+	{
+		return 1.0f;
+	}
+
+	const float MaxDistance = FMath::Max(CVarWeaponSignificanceDistance.GetValueOnGameThread(), 1.0f);
+	float Significance = 1.0f - FMath::Clamp(FVector::Dist(Weapon->GetActorLocation(), Viewpoint.GetLocation()) / MaxDistance, 0.0f, 1.0f);
+
+	if (!Weapon->WasRecentlyRendered(WeaponSignificance::RenderTolerance))
+	{
+		Significance *= WeaponSignificance::OffScreenScale;
+	}
+
+	// Projects without teams leave every weapon at full significance
+	if (LocalTeam != FGenericTeamId::NoTeam && FGenericTeamId::GetAttitude(LocalTeam, FGenericTeamId::GetTeamIdentifier(OwnerPawn)) == ETeamAttitude::Friendly)
+	{
+		Significance *= WeaponSignificance::FriendlyScale;
+	}
+
+	return Significance;
+}
+
+bool UWeaponSignificanceSubsystem::ConsumeEffectBudget(const AWeaponBase *Weapon, const EWeaponCosmetic Cosmetic)
+{
+	const int32 Budget = CVarWeaponEffectBudget.GetValueOnGameThread();
+	const float Significance = GetWeaponSignificance(Weapon);
+
+	// The less important an effect, the more of the frame's budget needs to be left for it to be played. Fully significant
+	// weapons still count towards the budget, but are never denied their effects
+	if (Budget <= 0 || Significance >= 1.0f || EffectsPlayed < Budget * Significance * WeaponSignificance::GetCosmeticWeight(Cosmetic))
+	{
+		EffectsPlayed++;
+		INC_DWORD_STAT(STAT_WeaponEffectsPlayed);
+		return true;
+	}
+
+	INC_DWORD_STAT(STAT_WeaponEffectsDropped);
+	return false;
+}
+
+bool UWeaponSignificanceSubsystem::ShouldSimplifyEffects(const AWeaponBase *Weapon) const
+{
+	return GetWeaponSignificance(Weapon) < WeaponSignificance::SimplifyThreshold;
+}
+
+void UWeaponSignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	EffectsPlayed = 0;
+	SET_DWORD_STAT(STAT_WeaponEffectBudget, FMath::Max(CVarWeaponEffectBudget.GetValueOnGameThread(), 0));
+
+	USignificanceManager *SignificanceManager = USignificanceManager::Get(GetWorld());
+	if (!SignificanceManager)
+	{
+		return;
+	}
+
+	// Scoring weapons against the view of every local player (split screen)
+	Viewpoints.Reset();
+	LocalTeam = FGenericTeamId::NoTeam;
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController *PlayerController = Iterator->Get();
+		if (!PlayerController || !PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		Viewpoints.Emplace(ViewRotation, ViewLocation);
+
+		if (LocalTeam == FGenericTeamId::NoTeam)
+		{
+			LocalTeam = FGenericTeamId::GetTeamIdentifier(PlayerController->GetPawn());
+		}
+	}
+
+	SignificanceManager->Update(Viewpoints);
+}
+
+TStatId UWeaponSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UWeaponSignificanceSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,309 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "VaultLedges.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+
+const TCHAR *UVaultLedgeData::PackageSuffix = TEXT("_VaultLedges");
+
+bool FVaultLedgeSettings::Matches(const FVaultLedgeSettings &Other) const
+{
+	return FMath::IsNearlyEqual(CapsuleRadius, Other.CapsuleRadius, 1.0f)
+		&& FMath::IsNearlyEqual(CapsuleHalfHeight, Other.CapsuleHalfHeight, 1.0f)
+		&& FMath::IsNearlyEqual(MaxMantleHeight, Other.MaxMantleHeight, 1.0f)
+		&& FMath::IsNearlyEqual(VaultSpaceHeight, Other.VaultSpaceHeight, 1.0f)
+		&& FMath::IsNearlyEqual(WalkableFloorZ, Other.WalkableFloorZ, 0.01f)
+		&& VaultTraceAmount == Other.VaultTraceAmount;
+}
+
+FString UVaultLedgeData::GetPackageNameForMap(const FString &MapPackageName)
+{
+	return MapPackageName + PackageSuffix;
+}
+
+const FVaultLedge *UVaultLedgeData::FindLedge(const FVector &Location, const FVector &Forward) const
+{
+	const FVector Forward2D = Forward.GetSafeNormal2D();
+	constexpr float Reach = FVaultLedgeSettings::WallCheckRadius + FVaultLedgeSettings::WallCheckDistance;
+
+	// Only the few cells that the character can reach need to be searched
+	const FIntVector MinCell = GetCellCoordinates(Location - FVector(Reach, Reach, 0.0f));
+	const FIntVector MaxCell = GetCellCoordinates(Location + FVector(Reach, Reach, FVaultLedgeSettings::LedgeCheckHeight));
+
+	const FVaultLedge *ClosestLedge = nullptr;
+	float ClosestDistanceSquared = MAX_flt;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				const int32 *CellIndex = CellLookup.Find(FIntVector(X, Y, Z));
+				if (!CellIndex)
+				{
+					continue;
+				}
+
+				const FVaultLedgeCell &Cell = Cells[*CellIndex];
+				for (int32 LedgeIndex = Cell.FirstLedge; LedgeIndex < Cell.FirstLedge + Cell.NumLedges; LedgeIndex++)
+				{
+					const FVaultLedge &Ledge = Ledges[LedgeIndex];
+
+					// The top of the wall has to be within reach above the character
+					const float EdgeHeight = Ledge.EdgeLocation.Z - Location.Z;
+					if (EdgeHeight <= 0.0f || EdgeHeight > FVaultLedgeSettings::LedgeCheckHeight)
+					{
+						continue;
+					}
+
+					// The character has to be facing the wall, and be in front of it
+					if ((Forward2D | Ledge.WallNormal) >= 0.0f)
+					{
+						continue;
+					}
+
+					const FVector ToEdge = FVector(Ledge.EdgeLocation.X - Location.X, Ledge.EdgeLocation.Y - Location.Y, 0.0f);
+					const float WallDistance = -(ToEdge | Ledge.WallNormal);
+					if (WallDistance < 0.0f || WallDistance > Reach)
+					{
+						continue;
+					}
+
+					// Ledges are baked every SampleSpacing along an edge, so the nearest one is never further to the side
+					if ((ToEdge + Ledge.WallNormal * WallDistance).SizeSquared() > FMath::Square(SampleSpacing))
+					{
+						continue;
+					}
+
+					const float DistanceSquared = ToEdge.SizeSquared();
+					if (DistanceSquared < ClosestDistanceSquared)
+					{
+						ClosestLedge = &Ledge;
+						ClosestDistanceSquared = DistanceSquared;
+					}
+				}
+			}
+		}
+	}
+
+	return ClosestLedge;
+}
+
+#if WITH_EDITOR
+void UVaultLedgeData::SetLedges(const FVaultLedgeSettings &NewSettings, const FBox &NewBounds, const float NewSampleSpacing, const float NewCellSize, TArray<FVaultLedge> NewLedges)
+{
+	Settings = NewSettings;
+	BakedBounds = NewBounds;
+	SampleSpacing = NewSampleSpacing;
+	CellSize = NewCellSize;
+
+	// Sorting the ledges by cell, so that every cell is a range of Ledges
+	TArray<TPair<FIntVector, int32>> LedgeCells;
+	LedgeCells.Reserve(NewLedges.Num());
+	for (int32 Index = 0; Index < NewLedges.Num(); Index++)
+	{
+		LedgeCells.Emplace(GetCellCoordinates(NewLedges[Index].EdgeLocation), Index);
+	}
+	LedgeCells.Sort([](const TPair<FIntVector, int32> &A, const TPair<FIntVector, int32> &B)
+	{
+		if (A.Key.X != B.Key.X)
+		{
+			return A.Key.X < B.Key.X;
+		}
+		if (A.Key.Y != B.Key.Y)
+		{
+			return A.Key.Y < B.Key.Y;
+		}
+		return A.Key.Z < B.Key.Z;
+	});
+
+	Ledges.Reset(NewLedges.Num());
+	Cells.Reset();
+	for (const TPair<FIntVector, int32> &LedgeCell : LedgeCells)
+	{
+		if (Cells.Num() == 0 || Cells.Last().Coordinates != LedgeCell.Key)
+		{
+			FVaultLedgeCell &Cell = Cells.AddDefaulted_GetRef();
+			Cell.Coordinates = LedgeCell.Key;
+			Cell.FirstLedge = Ledges.Num();
+		}
+		Ledges.Add(NewLedges[LedgeCell.Value]);
+		Cells.Last().NumLedges++;
+	}
+
+	BuildCellLookup();
+}
+#endif
+
+void UVaultLedgeData::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildCellLookup();
+}
+
+FIntVector UVaultLedgeData::GetCellCoordinates(const FVector &Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UVaultLedgeData::BuildCellLookup()
+{
+	CellLookup.Reset();
+	CellLookup.Reserve(Cells.Num());
+	for (int32 Index = 0; Index < Cells.Num(); Index++)
+	{
+		CellLookup.Add(Cells[Index].Coordinates, Index);
+	}
+}
+
+namespace
+{
+	/** The shape swept to look for walls in front of characters */
+	FCollisionShape GetWallCheckShape()
+	{
+		return FCollisionShape::MakeCapsule(FVaultLedgeSettings::WallCheckRadius, FVaultLedgeSettings::WallCheckHalfHeight);
+	}
+}
+
+bool FPSCore::TraceVaultLedge(const UWorld *World, const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, const FCollisionQueryParams &QueryParams, FVaultLedge &OutLedge, const bool bDrawDebug)
+{
+	const FVector EndLocation = Location + Forward * FVaultLedgeSettings::WallCheckDistance;
+	if (bDrawDebug)
+	{
+		DrawDebugCapsule(World, Location, FVaultLedgeSettings::WallCheckHalfHeight, FVaultLedgeSettings::WallCheckRadius, FQuat::Identity, FColor::Red);
+	}
+
+	// Checking if we are near a wall
+	FHitResult WallHit;
+	if (!World->SweepSingleByChannel(WallHit, Location, EndLocation, FQuat::Identity, ECC_WorldStatic, GetWallCheckShape(), QueryParams))
+		return false;
+
+	return TraceVaultLedgeFromWall(World, WallHit, Location, Forward, Settings, QueryParams, OutLedge, bDrawDebug);
+}
+
+FTraceHandle FPSCore::AsyncTraceVaultWall(UWorld *World, const FVector &Location, const FVector &Forward, const FCollisionQueryParams &QueryParams, FTraceDelegate *Delegate, const bool bDrawDebug)
+{
+	const FVector EndLocation = Location + Forward * FVaultLedgeSettings::WallCheckDistance;
+	if (bDrawDebug)
+	{
+		DrawDebugCapsule(World, Location, FVaultLedgeSettings::WallCheckHalfHeight, FVaultLedgeSettings::WallCheckRadius, FQuat::Identity, FColor::Red);
+	}
+
+	return World->AsyncSweepByChannel(EAsyncTraceType::Single, Location, EndLocation, FQuat::Identity, ECC_WorldStatic, GetWallCheckShape(), QueryParams, FCollisionResponseParams::DefaultResponseParam, Delegate);
+}
+
+bool FPSCore::TraceVaultLedgeFromWall(const UWorld *World, const FHitResult &WallHit, const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, const FCollisionQueryParams &QueryParams, FVaultLedge &OutLedge, const bool bDrawDebug)
+{
+	if (!WallHit.bBlockingHit)
+		return false;
+
+	const FVector ForwardImpactNormal = WallHit.ImpactNormal;
+	FVector CapsuleLocation = WallHit.ImpactPoint;
+	CapsuleLocation.Z = Location.Z;
+	CapsuleLocation += ForwardImpactNormal * -15;
+	FVector StartLocation = CapsuleLocation;
+	StartLocation.Z += FVaultLedgeSettings::LedgeCheckHeight;
+	FVector EndLocation = CapsuleLocation;
+
+	// Checking if we can stand up on the wall that we've hit
+	FHitResult TopHit;
+	if (!World->SweepSingleByChannel(TopHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeSphere(1), QueryParams))
+		return false;
+	if (TopHit.ImpactNormal.Z < Settings.WalkableFloorZ)
+		return false;
+
+	OutLedge.EdgeLocation = FVector(WallHit.ImpactPoint.X, WallHit.ImpactPoint.Y, TopHit.ImpactPoint.Z);
+	OutLedge.WallNormal = ForwardImpactNormal.GetSafeNormal2D();
+
+	FVector SecondaryVaultStartLocation = TopHit.ImpactPoint;
+	SecondaryVaultStartLocation.Z += 5;
+	FVector SecondaryVaultEndLocation = SecondaryVaultStartLocation;
+	SecondaryVaultEndLocation.Z = 0;
+	FVector SecondaryVaultHeightCheckLocation = SecondaryVaultStartLocation;
+	SecondaryVaultHeightCheckLocation.Z += Settings.VaultSpaceHeight;
+
+	if (bDrawDebug)
+	{
+		DrawDebugSphere(World, SecondaryVaultStartLocation, 10, 8, FColor::Orange);
+	}
+
+	float InitialTraceHeight = 0;
+	float PreviousTraceHeight = 0;
+	float CurrentTraceHeight = 0;
+	bool bInitialSwitch = false;
+
+	const FVector ForwardAddition = Forward * 5;
+	const float CalculationHeight = Settings.CapsuleHalfHeight + 2;
+	const float CapsuleWithoutHemisphere = Settings.CapsuleHalfHeight - Settings.CapsuleRadius;
+	FHitResult VaultHit;
+	FHitResult VaultHeightHit;
+
+	// Tracing downwards VaultTraceAmount times and looking for a significant change in height followed by a space large enough to stand
+	for (int32 i = 0; i <= Settings.VaultTraceAmount; i++)
+	{
+		SecondaryVaultStartLocation += ForwardAddition;
+		SecondaryVaultEndLocation += ForwardAddition;
+		SecondaryVaultHeightCheckLocation += ForwardAddition;
+		if (!World->LineTraceSingleByChannel(VaultHit, SecondaryVaultStartLocation, SecondaryVaultEndLocation, ECC_WorldStatic, QueryParams))
+			continue;
+		if (bDrawDebug)
+		{
+			DrawDebugLine(World, SecondaryVaultStartLocation, VaultHit.ImpactPoint, FColor::Red, false, 10.0f, 0.0f, 2.0f);
+			DrawDebugLine(World, SecondaryVaultStartLocation, SecondaryVaultHeightCheckLocation, FColor::Green, false, 10.0f, 0.0f, 2.0f);
+		}
+		if (World->LineTraceSingleByChannel(VaultHeightHit, SecondaryVaultStartLocation, SecondaryVaultHeightCheckLocation, ECC_WorldStatic, QueryParams))
+			break;
+
+		const float TraceLength = SecondaryVaultStartLocation.Z - VaultHit.ImpactPoint.Z;
+		if (!bInitialSwitch)
+		{
+			InitialTraceHeight = TraceLength;
+			bInitialSwitch = true;
+		}
+
+		PreviousTraceHeight = CurrentTraceHeight;
+		CurrentTraceHeight = TraceLength;
+		if (!(!(FMath::IsNearlyEqual(CurrentTraceHeight, InitialTraceHeight, 20.0f)) && CurrentTraceHeight < Settings.MaxMantleHeight))
+			continue;
+
+		if (!FMath::IsNearlyEqual(PreviousTraceHeight, CurrentTraceHeight, 3.0f))
+			continue;
+
+		FVector DownTracePoint = VaultHit.Location;
+		DownTracePoint.Z = VaultHit.ImpactPoint.Z + CalculationHeight;
+		StartLocation = DownTracePoint;
+		StartLocation.Z += CapsuleWithoutHemisphere;
+		EndLocation = DownTracePoint;
+		EndLocation.Z -= CapsuleWithoutHemisphere;
+
+		if (bDrawDebug)
+		{
+			DrawDebugCapsule(World, StartLocation, Settings.CapsuleHalfHeight, Settings.CapsuleRadius, FQuat::Identity, FColor::Green, false, 10.0f);
+		}
+		if (World->SweepSingleByChannel(VaultHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeSphere(Settings.CapsuleRadius), QueryParams))
+			continue;
+
+		// If we find such a location, we vault over the wall to it
+		OutLedge.LandingLocation = FVector(DownTracePoint.X, DownTracePoint.Y, DownTracePoint.Z - CalculationHeight);
+		OutLedge.bIsVault = true;
+		return true;
+	}
+
+	// If the vault has failed (there is no space or the surface is too high), we look for a place to mantle to instead
+	FVector DownTracePoint = TopHit.Location;
+	DownTracePoint.Z = TopHit.ImpactPoint.Z + CalculationHeight;
+	StartLocation = DownTracePoint;
+	StartLocation.Z += CapsuleWithoutHemisphere;
+	EndLocation = DownTracePoint;
+	EndLocation.Z -= CapsuleWithoutHemisphere;
+
+	FHitResult MantleHit;
+	if (World->SweepSingleByChannel(MantleHit, StartLocation, EndLocation, FQuat::Identity, ECC_WorldStatic, FCollisionShape::MakeSphere(Settings.CapsuleRadius), QueryParams))
+		return false;
+
+	OutLedge.LandingLocation = FVector(DownTracePoint.X, DownTracePoint.Y, TopHit.ImpactPoint.Z);
+	OutLedge.bIsVault = false;
+	return true;
+}
@@ -2,28 +2,43 @@
 
 #include "WeaponBase.h"
 #include "Animation/AnimationAsset.h"
+#include "Animation/AnimMontage.h"
 #include "Animation/AnimSequence.h"
+#include "Engine/AssetManager.h"
 #include "Engine/Engine.h"
 #include "Kismet/GameplayStatics.h"
 #include "DrawDebugHelpers.h"
-#include "NiagaraFunctionLibrary.h"
 #include "NiagaraComponent.h"
 #include "Math/UnrealMathUtility.h"
 #include "FPSCharacterController.h"
 #include "FPSCharacter.h"
+#include "FPSCore.h"
 #include "Camera/CameraComponent.h"
 #include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Subsystems/LagCompensationSubsystem.h"
+#include "Subsystems/ImpactAggregatorSubsystem.h"
+#include "Subsystems/ProjectileSubsystem.h"
+#include "Subsystems/ShotResolverSubsystem.h"
+#include "Subsystems/WeaponAudioSubsystem.h"
+#include "Subsystems/WeaponEffectPoolSubsystem.h"
+#include "Subsystems/WeaponSignificanceSubsystem.h"
+#include "WeaponSpread.h"
 
 // Sets default values
 AWeaponBase::AWeaponBase()
 {
     bReplicates = true;
-    bAlwaysRelevant = true;
     SetAutonomousProxy(true);
     bNetUseOwnerRelevancy = true;
+    NetCullDistanceSquared = FMath::Square(10000.0f);
+    NetUpdateFrequency = IdleNetUpdateFrequency;
+    MinNetUpdateFrequency = 1.0f;
 
-    // Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+    // Weapons only tick while they are firing or recovering from recoil (see UpdateTickEnabled)
     PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
 
     // Create first person mesh component
     MeshComp = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("MeshComp"));
@@ -81,6 +96,13 @@ void AWeaponBase::BeginPlay()
     if (HasAuthority())
     {
         SetOwner(GetInstigator());
+
+        // Picking the seed that every shot's spread is derived from, which is sent to clients along with the weapon
+        SpreadSeed = GetTypeHash(FGuid::NewGuid());
+        MARK_PROPERTY_DIRTY_FROM_NAME(AWeaponBase, SpreadSeed, this);
+
+        // Weapons start idle, and only update frequently while they are being fired
+        NetUpdateFrequency = IdleNetUpdateFrequency;
     }
 
     // Getting a reference to the relevant row in the WeaponData DataTable
@@ -93,6 +115,15 @@ void AWeaponBase::BeginPlay()
         GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::Red, TEXT("MISSING A WEAPON DATA TABLE NAME REFERENCE"));
     }
 
+    BuildSurfaceResponses();
+    LoadCosmetics();
+
+    // Scoring how significant this weapon's effects are to the local players
+    if (UWeaponSignificanceSubsystem *Significance = GetWorld()->GetSubsystem<UWeaponSignificanceSubsystem>())
+    {
+        Significance->RegisterWeapon(this);
+    }
+
     // Setting our default animation values
     // We set these here, but they can be overriden later by variables from applied attachments.
 
@@ -121,43 +152,56 @@ void AWeaponBase::BeginPlay()
         Anim_ADS_Idle = WeaponData.Anim_Ads_Idle;
     }
 
-    // Setting our recoil & recovery curves
-    if (VerticalRecoilCurve)
-    {
-        FOnTimelineFloat VerticalRecoilProgressFunction;
-        VerticalRecoilProgressFunction.BindUFunction(this, FName("HandleVerticalRecoilProgress"));
-        VerticalRecoilTimeline.AddInterpFloat(VerticalRecoilCurve, VerticalRecoilProgressFunction);
-    }
+    // Setting our recoil & recovery curves, and timing our actions
+    BakeRecoil();
+    BakeActionDurations();
 
-    if (HorizontalRecoilCurve)
+    // Attaching weapons to their respective character meshes
+    if (AFPSCharacter *CurrentPlayer = Cast<AFPSCharacter>(GetOwner()))
     {
-        FOnTimelineFloat HorizontalRecoilProgressFunction;
-        HorizontalRecoilProgressFunction.BindUFunction(this, FName("HandleHorizontalRecoilProgress"));
-        HorizontalRecoilTimeline.AddInterpFloat(HorizontalRecoilCurve, HorizontalRecoilProgressFunction);
+        MeshComp->AttachToComponent(CurrentPlayer->GetHandsMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, GetStaticWeaponData()->WeaponAttachmentSocketName);
+        SetTPAttachment();
     }
+}
 
-    if (RecoveryCurve)
+void AWeaponBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UWeaponSignificanceSubsystem *Significance = GetWorld()->GetSubsystem<UWeaponSignificanceSubsystem>())
     {
-        FOnTimelineFloat RecoveryProgressFunction;
-        RecoveryProgressFunction.BindUFunction(this, FName("Client_HandleRecoveryProgress"));
-        RecoilRecoveryTimeline.AddInterpFloat(RecoveryCurve, RecoveryProgressFunction);
+        Significance->UnregisterWeapon(this);
     }
 
-    // Attaching weapons to their respective character meshes
-    if (AFPSCharacter *CurrentPlayer = Cast<AFPSCharacter>(GetOwner()))
+    if (CosmeticsHandle.IsValid())
     {
-        MeshComp->AttachToComponent(CurrentPlayer->GetHandsMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, GetStaticWeaponData()->WeaponAttachmentSocketName);
-        SetTPAttachment();
+        CosmeticsHandle->CancelHandle();
+        CosmeticsHandle.Reset();
     }
+
+    Super::EndPlay(EndPlayReason);
 }
 
 void AWeaponBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty> &OutLifetimeProps) const
 {
     Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-    DOREPLIFETIME_CONDITION(AWeaponBase, bOnlyOwnerSee, COND_OwnerOnly);
-    DOREPLIFETIME_CONDITION(AWeaponBase, bOwnerNoSee, COND_SkipOwner);
-    DOREPLIFETIME_CONDITION(AWeaponBase, TPMeshComp, COND_SkipOwner);
+    // Every property is push based, so it is only compared when it has been marked dirty
+    FDoRepLifetimeParams OwnerOnlyParams;
+    OwnerOnlyParams.bIsPushBased = true;
+    OwnerOnlyParams.Condition = COND_OwnerOnly;
+
+    FDoRepLifetimeParams SkipOwnerParams;
+    SkipOwnerParams.bIsPushBased = true;
+    SkipOwnerParams.Condition = COND_SkipOwner;
+
+    FDoRepLifetimeParams InitialOnlyParams;
+    InitialOnlyParams.bIsPushBased = true;
+    InitialOnlyParams.Condition = COND_InitialOnly;
+
+    DOREPLIFETIME_WITH_PARAMS_FAST(AWeaponBase, bOnlyOwnerSee, OwnerOnlyParams);
+    DOREPLIFETIME_WITH_PARAMS_FAST(AWeaponBase, bOwnerNoSee, SkipOwnerParams);
+    DOREPLIFETIME_WITH_PARAMS_FAST(AWeaponBase, TPMeshComp, SkipOwnerParams);
+    DOREPLIFETIME_WITH_PARAMS_FAST(AWeaponBase, ConfirmedShot, OwnerOnlyParams);
+    DOREPLIFETIME_WITH_PARAMS_FAST(AWeaponBase, SpreadSeed, InitialOnlyParams);
 }
 
 void AWeaponBase::SetTPAttachment()
@@ -168,6 +212,28 @@ void AWeaponBase::SetTPAttachment()
     }
 }
 
+void AWeaponBase::SetOwner(AActor *NewOwner)
+{
+    const bool bOwnerChanged = NewOwner != GetOwner();
+    Super::SetOwner(NewOwner);
+
+    // Attaching is done in BeginPlay for the owner we spawn with, once the socket names have been read from WeaponData
+    if (bOwnerChanged && HasActorBegunPlay())
+    {
+        SetTPAttachment();
+    }
+}
+
+void AWeaponBase::OnRep_Owner()
+{
+    Super::OnRep_Owner();
+
+    if (HasActorBegunPlay())
+    {
+        SetTPAttachment();
+    }
+}
+
 void AWeaponBase::SpawnAttachments()
 {
     if (WeaponData.bHasAttachments)
@@ -273,29 +339,246 @@ void AWeaponBase::SpawnAttachments()
                 }
             }
         }
+
+        // Baking the recoil and action durations again with the curves, modifiers and animations of the attachments
+        BakeRecoil();
+        BakeActionDurations();
     }
 }
 
 // Start Fire
 
-void AWeaponBase::StartFire(FVector CameraLocation, FRotator CameraRotation)
+void AWeaponBase::StartFire(FVector CameraLocation, FRotator CameraRotation, const double ShotTimestamp, const uint16 FirstShotId)
 {
+    // Skipping over any predicted shots that we have refused, so that the client does not keep waiting on them
+    AcknowledgeShots(FirstShotId - 1);
+
     if (bCanFire)
     {
-        // sets a timer for firing the weapon - if bAutomaticFire is true then this timer will repeat until cleared by StopFire(), leading to fully automatic fire
-        GetWorldTimerManager().SetTimer(
-            ShotDelay, [this, CameraLocation, CameraRotation]()
-            { Fire(CameraLocation, CameraRotation); },
-            (60 / WeaponData.RateOfFire), WeaponData.bAutomaticFire, 0.0f);
+        // Keeping track of how far behind the server the shooter is, so that every shot of this burst is rewound by the same amount.
+        // The listen server's own player sees the present, and is never rewound for
+        RewindTimeOffset = 0.0;
+        if (HasAuthority() && !IsOwnerLocallyControlled())
+        {
+            if (const ULagCompensationSubsystem *LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+            {
+                RewindTimeOffset = GetWorld()->GetTimeSeconds() - LagCompensation->ClampRewindTimestamp(ShotTimestamp);
+            }
+        }
+
+        // Starts the fire scheduler - if bAutomaticFire is true then it will keep firing until stopped by StopFire(), leading to fully automatic fire
+        BeginFiring(CameraLocation, CameraRotation);
 
         if (bShowDebug)
         {
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, TEXT("Started firing timer"));
+            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, TEXT("Started firing"));
         }
 
-        // Simultaneously begins to play the recoil timeline
+        // Simultaneously begins to play the recoil timeline, if we are the ones holding the weapon (listen servers)
+        if (IsOwnerLocallyControlled())
+        {
+            StartRecoil();
+        }
+    }
+}
 
-        Client_StartRecoil();
+void AWeaponBase::StartPredictedFire(FVector CameraLocation, FRotator CameraRotation)
+{
+    if (bCanFire)
+    {
+        // Running the same fire scheduler as the server, so that shots, effects and ammunition happen immediately on our end
+        BeginFiring(CameraLocation, CameraRotation);
+
+        StartRecoil();
+    }
+}
+
+void AWeaponBase::BeginFiring(const FVector &CameraLocation, const FRotator &CameraRotation)
+{
+    // Confirming shots to the owner quickly while firing
+    if (HasAuthority())
+    {
+        NetUpdateFrequency = FiringNetUpdateFrequency;
+    }
+
+    // The first shot is fired straight away, using the exact aim that the player had when pulling the trigger
+    LastAimLocation = CameraLocation;
+    LastAimRotation = CameraRotation.Quaternion();
+    TriggerPullTime = GetWorld()->GetTimeSeconds();
+    TimeUntilNextShot = 0.0;
+    bTriggerHeld = true;
+    RunFireScheduler(0.0f, LastAimLocation, LastAimRotation);
+
+    // Ticking to keep firing, if the trigger is still held after the first shot
+    UpdateTickEnabled();
+}
+
+void AWeaponBase::GetCurrentAim(FVector &OutLocation, FRotator &OutRotation) const
+{
+    const AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
+    OutLocation = PlayerCharacter->GetCameraComponent()->GetComponentLocation();
+    OutRotation = PlayerCharacter->GetControlRotation();
+}
+
+void AWeaponBase::RunFireScheduler(const float DeltaTime, const FVector &AimLocation, const FQuat &AimRotation)
+{
+    // The loop below never ends without a positive rate of fire, which data that bypassed the editor's clamp may lack
+    if (WeaponData.RateOfFire <= 0.0f)
+    {
+        bTriggerHeld = false;
+        return;
+    }
+
+    // The frame during which the trigger was pulled only counts from the trigger pull, so that no shot is fired, timed or
+    // aimed from before it
+    const double Now = GetWorld()->GetTimeSeconds();
+    const float ElapsedTime = FMath::Min(DeltaTime, static_cast<float>(Now - TriggerPullTime));
+    const double FrameStartTime = Now - ElapsedTime;
+    const double ShotInterval = 60.0 / WeaponData.RateOfFire;
+
+    // Firing every shot that was due during this frame, which may be several if the rate of fire is higher than the tick rate
+    while (bTriggerHeld && TimeUntilNextShot <= ElapsedTime)
+    {
+        // Interpolating the aim between the previous frame and this one, to where it was at the moment the shot was due
+        const float Alpha = ElapsedTime > 0.0f ? static_cast<float>(TimeUntilNextShot / ElapsedTime) : 1.0f;
+        const FVector ShotLocation = FMath::Lerp(LastAimLocation, AimLocation, Alpha);
+        const FRotator ShotRotation = FQuat::Slerp(LastAimRotation, AimRotation, Alpha).Rotator();
+
+        if (IsLocallyPredicting())
+        {
+            PredictFire(ShotLocation, ShotRotation);
+        }
+        else
+        {
+            Fire(ShotLocation, ShotRotation, FrameStartTime + TimeUntilNextShot);
+        }
+
+        TimeUntilNextShot += ShotInterval;
+
+        if (!WeaponData.bAutomaticFire)
+        {
+            bTriggerHeld = false;
+        }
+    }
+
+    // Carrying the remainder over to the next frame, so that the average rate of fire matches RateOfFire at any tick rate
+    TimeUntilNextShot = FMath::Max(TimeUntilNextShot - ElapsedTime, 0.0);
+    LastAimLocation = AimLocation;
+    LastAimRotation = AimRotation;
+}
+
+void AWeaponBase::AcknowledgeShots(const uint16 ClientShotId)
+{
+    // Shot IDs wrap around, so we compare them through their signed difference. The shot ID seeds the spread of the
+    // shot, so a client is only allowed to skip the few shots that we may have refused, rather than pick its own
+    const int32 SkippedShots = static_cast<int16>(ClientShotId - LastShotId);
+    if (SkippedShots > MaxSkippedShots)
+    {
+        ConfirmedShot.ResyncCount++;
+    }
+    else if (SkippedShots > 0)
+    {
+        LastShotId = ClientShotId;
+    }
+    ConfirmShotState();
+}
+
+void AWeaponBase::ConfirmShotState()
+{
+    ConfirmedShot.ShotId = LastShotId;
+    ConfirmedShot.ClipSize = GeneralWeaponData.ClipSize;
+    ConfirmedShot.bIsReloading = bIsReloading;
+    MARK_PROPERTY_DIRTY_FROM_NAME(AWeaponBase, ConfirmedShot, this);
+
+    // Changes made while idle (reloads, ammunition) are sent straight away rather than at the idle update rate
+    if (HasAuthority())
+    {
+        if (NetDormancy > DORM_Awake)
+        {
+            FlushNetDormancy();
+        }
+        else if (!bTriggerHeld)
+        {
+            ForceNetUpdate();
+        }
+    }
+}
+
+void AWeaponBase::SetHolstered(const bool bHolstered)
+{
+    // Unregistering the tick of holstered weapons, rather than only skipping their updates
+    bIsHolstered = bHolstered;
+    if (bHolstered)
+    {
+        bIsRecovering = false;
+    }
+    UpdateTickEnabled();
+
+    SetActorHiddenInGame(bHolstered);
+
+    // Holstered weapons have nothing to replicate until they are taken out again. Dormancy only takes effect once the
+    // hidden state above has been sent
+    if (HasAuthority())
+    {
+        SetNetDormancy(bHolstered ? DORM_DormantAll : DORM_Awake);
+    }
+}
+
+bool AWeaponBase::IsNetRelevantFor(const AActor *RealViewer, const AActor *ViewTarget, const FVector &SrcLocation) const
+{
+    // The owner's relevancy (bNetUseOwnerRelevancy) comes first, and the owning connection always receives its weapons
+    if (!Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation))
+    {
+        return false;
+    }
+    if (IsOwnedBy(ViewTarget) || IsOwnedBy(RealViewer))
+    {
+        return true;
+    }
+
+    return FVector::DistSquared(SrcLocation, GetActorLocation()) < NetCullDistanceSquared;
+}
+
+void AWeaponBase::OnRep_ConfirmedShot()
+{
+    // Shots that we have predicted but which the server has not processed yet
+    int32 PendingShots = static_cast<int16>(LastShotId - ConfirmedShot.ShotId);
+    if (ConfirmedShot.ResyncCount != LastResyncCount)
+    {
+        // The server refused our shot IDs, so we continue from its own
+        LastResyncCount = ConfirmedShot.ResyncCount;
+        LastShotId = ConfirmedShot.ShotId;
+        PendingShots = 0;
+    }
+    else if (PendingShots < 0)
+    {
+        // The server has fired more shots than we predicted, so we adopt its count
+        LastShotId = ConfirmedShot.ShotId;
+        PendingShots = 0;
+    }
+
+    // Taking the server's ammunition count and re-applying the shots that are still in flight
+    GeneralWeaponData.ClipSize = FMath::Max(ConfirmedShot.ClipSize - PendingShots, 0);
+
+    if (bIsReloading != ConfirmedShot.bIsReloading)
+    {
+        bIsReloading = ConfirmedShot.bIsReloading;
+        if (bIsReloading)
+        {
+            // Matching the server, which prevents firing for the duration of the reload
+            bTriggerHeld = false;
+            bCanFire = false;
+        }
+        else
+        {
+            // Making sure the player cannot fire if sliding
+            const AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
+            if (!PlayerCharacter || PlayerCharacter->GetMovementState() != EMovementState::State_Slide)
+            {
+                EnableFire();
+            }
+            bIsWeaponReadyToFire = true;
+        }
     }
 }
 
@@ -308,24 +591,14 @@ void AWeaponBase::StartRecoil()
 
     if (bCanFire && !bIsReloading && CharacterController)
     {
-        // Plays the recoil timelines and saves the current control rotation in order to recover to it
-        VerticalRecoilTimeline.PlayFromStart();
-        HorizontalRecoilTimeline.PlayFromStart();
+        // Saves the current control rotation in order to recover to it. The recoil of each shot is then looked up from its
+        // index within the burst, so nothing needs to play while firing
+        bIsRecovering = false;
         ControlRotation = CharacterController->GetControlRotation();
         bShouldRecover = true;
     }
 }
 
-bool AWeaponBase::Client_StartRecoil_Validate()
-{
-    return true;
-}
-
-void AWeaponBase::Client_StartRecoil_Implementation()
-{
-    StartRecoil();
-}
-
 void AWeaponBase::EnableFire()
 {
     // Fairly self explanatory - allows the weapon to fire again after waiting for an animation to finish or finishing a reload
@@ -340,19 +613,38 @@ void AWeaponBase::ReadyToFire()
 void AWeaponBase::StopFire()
 {
     // Stops the gun firing (for automatic fire)
-    VerticalRecoilTimeline.Stop();
-    HorizontalRecoilTimeline.Stop();
-    Client_RecoilRecovery();
+    if (IsOwnerLocallyControlled())
+    {
+        RecoilRecovery();
+    }
     ShotsFired = 0;
 
+    // Ending the fire loop straight away rather than waiting for it to time out
+    if (UWeaponAudioSubsystem *WeaponAudio = GetWorld()->GetSubsystem<UWeaponAudioSubsystem>())
+    {
+        WeaponAudio->StopFireLoop(this);
+    }
+
+    // Dropping back to the idle update rate, after sending the final state of the burst
+    if (HasAuthority())
+    {
+        NetUpdateFrequency = IdleNetUpdateFrequency;
+        ForceNetUpdate();
+    }
+
     if (WeaponData.bPreventRapidManualFire && bHasFiredRecently)
     {
         bHasFiredRecently = false;
-        bIsWeaponReadyToFire = false;
         GetWorldTimerManager().ClearTimer(SpamFirePreventionDelay);
-        GetWorldTimerManager().SetTimer(SpamFirePreventionDelay, this, &AWeaponBase::ReadyToFire, GetWorldTimerManager().GetTimerRemaining(ShotDelay), false, GetWorldTimerManager().GetTimerRemaining(ShotDelay));
+
+        // Preventing the next shot until the current shot interval has elapsed
+        if (TimeUntilNextShot > 0.0)
+        {
+            bIsWeaponReadyToFire = false;
+            GetWorldTimerManager().SetTimer(SpamFirePreventionDelay, this, &AWeaponBase::ReadyToFire, TimeUntilNextShot, false, TimeUntilNextShot);
+        }
     }
-    GetWorldTimerManager().ClearTimer(ShotDelay);
+    bTriggerHeld = false;
 }
 
 bool AWeaponBase::Client_StopFire_Validate()
@@ -365,7 +657,28 @@ void AWeaponBase::Client_StopFire_Implementation()
     StopFire();
 }
 
-void AWeaponBase::Fire(FVector CameraLocation, FRotator CameraRotation)
+USceneComponent *AWeaponBase::GetSoundSourceComponent() const
+{
+    // Remote players' weapons are seen through the third person mesh, so their sounds should come from it too
+    const APawn *OwnerPawn = Cast<APawn>(GetOwner());
+    return OwnerPawn && !OwnerPawn->IsLocallyControlled() ? TPMeshComp : MeshComp;
+}
+
+bool AWeaponBase::IsOwnerLocallyControlled() const
+{
+    // Recoil only ever affects the view of the player holding the weapon
+    const APawn *OwnerPawn = Cast<APawn>(GetOwner());
+    return OwnerPawn && OwnerPawn->IsLocallyControlled();
+}
+
+bool AWeaponBase::IsLocallyPredicting() const
+{
+    // Remote clients that control this weapon predict their own shots instead of waiting on the server
+    const APawn *OwnerPawn = Cast<APawn>(GetOwner());
+    return !HasAuthority() && OwnerPawn && OwnerPawn->IsLocallyControlled();
+}
+
+void AWeaponBase::Fire(FVector CameraLocation, FRotator CameraRotation, const double ShotTime)
 {
     // Allowing the gun to fire if it has ammunition, is not reloading and the bCanFire variable is true
     if (bCanFire && bIsWeaponReadyToFire && GeneralWeaponData.ClipSize > 0 && !bIsReloading)
@@ -382,212 +695,568 @@ void AWeaponBase::Fire(FVector CameraLocation, FRotator CameraRotation)
 
         // Subtracting from the ammunition count of the weapon
         GeneralWeaponData.ClipSize -= 1;
+        LastShotId++;
 
-        const int NumberOfShots = WeaponData.bIsShotgun ? WeaponData.ShotgunPellets : 1;
-        // We run this for the number of bullets/projectiles per shot, in order to support shotguns
+        // Applying Recoil to the weapon (once per shot, regardless of how many pellets are fired). Remote clients apply
+        // their own recoil as they predict their shots, and send us the resulting aim with their moves
+        if (IsOwnerLocallyControlled())
+        {
+            Recoil();
+        }
 
-        for (int i = 0; i < NumberOfShots; i++)
+        // Line traces are handed to the shot resolver, which traces every shot fired this frame at once and sends the
+        // impacts to our clients when it is done
+        UShotResolverSubsystem *ShotResolver = WeaponData.bUseProjectiles ? nullptr : GetWorld()->GetSubsystem<UShotResolverSubsystem>();
+        if (ShotResolver)
         {
+            ShotResolver->QueueShot(this, CameraLocation, CameraRotation, RewindTimeOffset > 0.0 ? ShotTime - RewindTimeOffset : GetWorld()->GetTimeSeconds());
+        }
+        else
+        {
+            // Rewinding the other players to where the shooter saw them when they pulled the trigger
+            ULagCompensationSubsystem *LagCompensation = nullptr;
+            if (HasAuthority() && RewindTimeOffset > 0.0)
+            {
+                LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>();
+                if (LagCompensation)
+                {
+                    LagCompensation->RewindCharacters(ShotTime - RewindTimeOffset, PlayerCharacter);
+                }
+            }
 
-            // Calculating the start and end points of our line trace, and applying randomised variation
-            TraceStart = CameraLocation;
-            TraceStartRotation = CameraRotation;
+            FWeaponImpactBatch ImpactBatch;
+            TracePellets(CameraLocation, CameraRotation, true, ImpactBatch);
 
-            float AccuracyMultiplier = 1.0f;
-            if (PlayerCharacter->GetMovementState() == EMovementState::State_Sprint)
+            // Returning the other players to their present positions
+            if (LagCompensation)
             {
-                AccuracyMultiplier = WeaponData.AccuracyDebuff;
+                LagCompensation->RestoreCharacters();
             }
 
-            TraceStartRotation.Pitch += FMath::FRandRange(-((WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier), (WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier);
-            TraceStartRotation.Yaw += FMath::FRandRange(-((WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier), (WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier);
-            TraceDirection = TraceStartRotation.Vector();
-            TraceEnd = TraceStart + (TraceDirection * (WeaponData.bIsShotgun ? WeaponData.ShotgunRange : WeaponData.LengthMultiplier));
+            // Sending every pellet to our clients at once
+            Multi_Fire(ImpactBatch);
+        }
+        Multi_FireOnce();
+        CycleShot();
+
+        // Letting the owning client know which of its predicted shots we have processed
+        ConfirmShotState();
+    }
+    else if (bCanFire && !bIsReloading)
+    {
+        Multi_Fire_NoBullets();
+    }
+}
+
+void AWeaponBase::PredictFire(FVector CameraLocation, FRotator CameraRotation)
+{
+    // Mirroring the conditions used by the server, so that we only predict shots which the server will also fire
+    if (bCanFire && bIsWeaponReadyToFire && GeneralWeaponData.ClipSize > 0 && !bIsReloading)
+    {
+        // Predicting the ammunition count, which is corrected by the server in OnRep_ConfirmedShot
+        GeneralWeaponData.ClipSize -= 1;
+        LastShotId++;
 
-            // Applying Recoil to the weapon
-            Client_Recoil();
+        Recoil();
 
-            EndPoint = TraceEnd;
+        // Tracing locally for cosmetics only - damage is always dealt by the server
+        FWeaponImpactBatch ImpactBatch;
+        TracePellets(CameraLocation, CameraRotation, false, ImpactBatch);
 
-            // Sets the default values for our trace query
-            QueryParams.AddIgnoredActor(this);
-            QueryParams.AddIgnoredActor(PlayerCharacter);
-            QueryParams.bTraceComplex = true;
-            QueryParams.bReturnPhysicalMaterial = true;
+        PlayImpactEffects(ImpactBatch);
+        PlayFireEffects();
+        CycleShot();
+    }
+    else if (bCanFire && !bIsReloading)
+    {
+        PlayEmptyFireEffects();
+    }
+}
 
-            // Drawing a line trace based on the parameters calculated previously
-            if (GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, ECC_GameTraceChannel1, QueryParams))
-            {
-                // Drawing debug line trace
-                if (bShowDebug)
-                {
-                    // Debug line from muzzle to hit location
-                    DrawDebugLine(
-                        GetWorld(), (WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), Hit.Location,
-                        FColor::Red, false, 10.0f, 0.0f, 2.0f);
+void AWeaponBase::PrepareShot(const FVector &CameraLocation, const FRotator &CameraRotation, FWeaponImpactBatch &OutImpactBatch) const
+{
+    const AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
 
-                    if (bDrawObstructiveDebugs)
-                    {
-                        // Debug line from camera to hit location
-                        DrawDebugLine(GetWorld(), TraceStart, Hit.Location, FColor::Orange, false, 10.0f, 0.0f, 2.0f);
+    float AccuracyMultiplier = 1.0f;
+    if (PlayerCharacter->GetMovementState() == EMovementState::State_Sprint)
+    {
+        AccuracyMultiplier = WeaponData.AccuracyDebuff;
+    }
 
-                        // Debug line from camera to target location
-                        DrawDebugLine(GetWorld(), TraceStart, TraceEnd, FColor::Green, false, 10.0f, 0.0f, 2.0f);
-                    }
-                }
+    // Quantizing the parameters of the shot before using them, so that clients rebuild exactly the same pellets as us
+    OutImpactBatch.Origin = FWeaponSpread::QuantizeOrigin(CameraLocation);
+    OutImpactBatch.Aim = FWeaponSpread::QuantizeAim(CameraRotation);
+    OutImpactBatch.ShotId = LastShotId;
+    OutImpactBatch.PitchSpread = FWeaponSpread::QuantizeSpread((WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier);
+    OutImpactBatch.YawSpread = FWeaponSpread::QuantizeSpread((WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier);
+}
 
-                // Resetting finalDamage
-                FinalDamage = 0.0f;
+FRotator AWeaponBase::GetPelletRotation(const FWeaponImpactBatch &ImpactBatch, const int32 PelletIndex) const
+{
+    const uint32 ShotSeed = FWeaponSpread::GetShotSeed(SpreadSeed, ImpactBatch.ShotId);
+    return FWeaponSpread::GetPelletRotation(ImpactBatch.Aim, ShotSeed, PelletIndex, FWeaponSpread::DequantizeSpread(ImpactBatch.PitchSpread), FWeaponSpread::DequantizeSpread(ImpactBatch.YawSpread));
+}
 
-                // Setting finalDamage based on the type of surface hit
-                FinalDamage = (WeaponData.BaseDamage + DamageModifier);
+void AWeaponBase::TracePellets(const FVector &CameraLocation, const FRotator &CameraRotation, const bool bAuthoritative, FWeaponImpactBatch &OutImpactBatch)
+{
+    AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
 
-                if (Hit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
-                {
-                    FinalDamage = (WeaponData.BaseDamage + DamageModifier) * WeaponData.HeadshotMultiplier;
-                }
+    // Sets the default values for our trace query
+    QueryParams.AddIgnoredActor(this);
+    QueryParams.AddIgnoredActor(PlayerCharacter);
+    QueryParams.bTraceComplex = true;
+    QueryParams.bReturnPhysicalMaterial = true;
 
-                AActor *HitActor = Hit.GetActor();
+    PrepareShot(CameraLocation, CameraRotation, OutImpactBatch);
 
-                // Applying the previously set damage to the hit actor
-                UGameplayStatics::ApplyPointDamage(HitActor, FinalDamage, TraceDirection, Hit, GetOwner()->GetInstigatorController(), this, DamageType);
+    const int NumberOfShots = GetNumPellets();
+    const float Range = GetShotRange();
+
+    UProjectileSubsystem *Projectiles = WeaponData.bUseProjectiles ? GetWorld()->GetSubsystem<UProjectileSubsystem>() : nullptr;
+
+    // We run this for the number of bullets/projectiles per shot, in order to support shotguns
+    for (int i = 0; i < NumberOfShots; i++)
+    {
+
+        // Calculating the start and end points of our line trace, and applying the seeded variation
+        TraceStart = OutImpactBatch.Origin;
+        TraceStartRotation = GetPelletRotation(OutImpactBatch, i);
+        TraceDirection = TraceStartRotation.Vector();
+        TraceEnd = TraceStart + (TraceDirection * Range);
+
+        EndPoint = TraceEnd;
+
+        // Projectile weapons hand the pellet over to the projectile simulation instead of tracing it. Clients simulate
+        // their own cosmetic projectiles when playing the shot's effects
+        if (WeaponData.bUseProjectiles)
+        {
+            if (bAuthoritative && Projectiles)
+            {
+                Projectiles->SpawnProjectile(this, TraceStart, TraceDirection * WeaponData.MuzzleVelocity, WeaponData.ProjectileGravityScale, WeaponData.ProjectileDrag, WeaponData.ProjectileLifetime, true);
+            }
+            continue;
+        }
 
-                EndPoint = Hit.Location;
+        // Drawing a line trace based on the parameters calculated previously
+        if (GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, ECC_GameTraceChannel1, QueryParams))
+        {
+            // Drawing debug line trace
+            if (bShowDebug)
+            {
+                // Debug line from muzzle to hit location
+                DrawDebugLine(
+                    GetWorld(), (WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), Hit.Location,
+                    FColor::Red, false, 10.0f, 0.0f, 2.0f);
 
-                // Passing hit delegate to InventoryComponent
-                AFPSCharacter *PlayerRef = Cast<AFPSCharacter>(GetOwner());
-                if (PlayerRef)
+                if (bDrawObstructiveDebugs)
                 {
-                    UInventoryComponent *PlayerInventoryComp = PlayerRef->FindComponentByClass<UInventoryComponent>();
-                    if (IsValid(PlayerInventoryComp))
-                    {
-                        PlayerInventoryComp->EventHitActor.Broadcast(Hit);
-                    }
+                    // Debug line from camera to hit location
+                    DrawDebugLine(GetWorld(), TraceStart, Hit.Location, FColor::Orange, false, 10.0f, 0.0f, 2.0f);
+
+                    // Debug line from camera to target location
+                    DrawDebugLine(GetWorld(), TraceStart, TraceEnd, FColor::Green, false, 10.0f, 0.0f, 2.0f);
                 }
             }
-            else
+
+            EndPoint = Hit.Location;
+
+            // Storing the hit for our clients, who work out the rest of the pellet from the shot's seed
+            FWeaponImpact &Impact = OutImpactBatch.Impacts.AddDefaulted_GetRef();
+            Impact.PelletIndex = static_cast<uint8>(i);
+            Impact.Distance = Hit.Distance;
+            Impact.HitComponent = Hit.GetComponent();
+            Impact.SurfaceResponse = static_cast<uint8>(GetSurfaceResponseIndex(Hit.PhysMaterial.Get()));
+
+            if (bAuthoritative)
             {
-                // Drawing debug line trace
-                if (bShowDebug)
-                {
-                    DrawDebugLine(
-                        GetWorld(), (WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), TraceEnd,
-                        FColor::Red, false, 10.0f, 0.0f, 2.0f);
+                ApplyHitDamage(Hit, TraceDirection);
+            }
+        }
+        else
+        {
+            // Drawing debug line trace
+            if (bShowDebug)
+            {
+                DrawDebugLine(
+                    GetWorld(), (WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), TraceEnd,
+                    FColor::Red, false, 10.0f, 0.0f, 2.0f);
 
-                    if (bDrawObstructiveDebugs)
-                    {
-                        // Debug line from camera to target location
-                        DrawDebugLine(GetWorld(), TraceStart, TraceEnd, FColor::Green, false, 10.0f, 0.0f, 2.0f);
-                    }
+                if (bDrawObstructiveDebugs)
+                {
+                    // Debug line from camera to target location
+                    DrawDebugLine(GetWorld(), TraceStart, TraceEnd, FColor::Green, false, 10.0f, 0.0f, 2.0f);
                 }
             }
-            Multi_Fire(Hit);
         }
-        Multi_FireOnce();
-        if (!WeaponData.bAutomaticFire)
+    }
+}
+
+void AWeaponBase::ApplyHitDamage(const FHitResult &HitResult, const FVector &ShotDirection)
+{
+    // Resetting finalDamage
+    FinalDamage = 0.0f;
+
+    // Setting finalDamage based on the type of surface hit
+    FinalDamage = (WeaponData.BaseDamage + DamageModifier) * GetSurfaceResponse(GetSurfaceResponseIndex(HitResult.PhysMaterial.Get())).DamageMultiplier;
+
+    AActor *HitActor = HitResult.GetActor();
+
+    // Projectiles may land after their shooter has left, in which case the damage has no instigator
+    const AActor *Owner = GetOwner();
+    AController *InstigatorController = Owner ? Owner->GetInstigatorController() : nullptr;
+
+    // Applying the previously set damage to the hit actor
+    UGameplayStatics::ApplyPointDamage(HitActor, FinalDamage, ShotDirection, HitResult, InstigatorController, this, DamageType);
+
+    // Passing hit delegate to InventoryComponent
+    if (const AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner()))
+    {
+        UInventoryComponent *PlayerInventoryComp = PlayerCharacter->FindComponentByClass<UInventoryComponent>();
+        if (IsValid(PlayerInventoryComp))
+        {
+            PlayerInventoryComp->EventHitActor.Broadcast(HitResult);
+        }
+    }
+}
+
+void AWeaponBase::OnProjectileHit(const FHitResult &HitResult, const FVector &Direction, const bool bAuthoritative)
+{
+    if (bAuthoritative)
+    {
+        ApplyHitDamage(HitResult, Direction);
+    }
+
+    // Dedicated servers have nobody to show the impact to
+    if (FPSCore::ShouldPlayCosmetics(this))
+    {
+        const FSurfaceResponse &Response = GetSurfaceResponse(GetSurfaceResponseIndex(HitResult.PhysMaterial.Get()));
+        PlaySurfaceImpact(Response, HitResult.GetComponent(), HitResult.ImpactPoint, HitResult.ImpactNormal);
+    }
+}
+
+void AWeaponBase::PlaySurfaceImpact(const FSurfaceResponse &Response, USceneComponent *HitComponent, const FVector &Location, const FVector &Normal)
+{
+    // Surfaces with a batched effect are rendered together with every other hit on them this frame
+    UNiagaraSystem *BatchedImpactEffect = Response.BatchedImpactEffect.Get();
+    UImpactAggregatorSubsystem *ImpactAggregator = BatchedImpactEffect ? GetWorld()->GetSubsystem<UImpactAggregatorSubsystem>() : nullptr;
+    if (ImpactAggregator)
+    {
+        ImpactAggregator->AddImpact(BatchedImpactEffect, Location, Normal);
+    }
+    else if (UWeaponEffectPoolSubsystem *EffectPool = GetWorld()->GetSubsystem<UWeaponEffectPoolSubsystem>())
+    {
+        EffectPool->SpawnEffectAttached(Response.ImpactEffect.Get(), HitComponent, NAME_None, Location, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition);
+    }
+
+    if (UWeaponAudioSubsystem *WeaponAudio = GetWorld()->GetSubsystem<UWeaponAudioSubsystem>())
+    {
+        WeaponAudio->PlayWeaponSound(this, Response.ImpactSound.Get(), Location);
+    }
+}
+
+void AWeaponBase::PrewarmEffects()
+{
+    // The effect pool does not exist on dedicated servers
+    UWeaponEffectPoolSubsystem *EffectPool = GetWorld()->GetSubsystem<UWeaponEffectPoolSubsystem>();
+    if (!EffectPool)
+    {
+        return;
+    }
+
+    const int32 PoolSize = WeaponData.EffectPoolSize;
+    const int32 PelletPoolSize = PoolSize * GetNumPellets();
+
+    EffectPool->Prewarm(WeaponData.MuzzleFlash.Get(), PoolSize);
+    EffectPool->Prewarm(EjectedCasing.Get(), PoolSize);
+    EffectPool->Prewarm(WeaponData.BulletTrace.Get(), PelletPoolSize);
+
+    // Several surfaces usually share the same impact effect, which only needs to be prewarmed once
+    UImpactAggregatorSubsystem *ImpactAggregator = GetWorld()->GetSubsystem<UImpactAggregatorSubsystem>();
+    TSet<UNiagaraSystem *, DefaultKeyFuncs<UNiagaraSystem *>, TInlineSetAllocator<8>> ImpactEffects;
+    for (const FSurfaceResponse &Response : SurfaceResponses)
+    {
+        if (Response.BatchedImpactEffect.Get() && ImpactAggregator)
+        {
+            ImpactAggregator->Prewarm(Response.BatchedImpactEffect.Get());
+        }
+        else
+        {
+            ImpactEffects.Add(Response.ImpactEffect.Get());
+        }
+    }
+    for (UNiagaraSystem *ImpactEffect : ImpactEffects)
+    {
+        EffectPool->Prewarm(ImpactEffect, PelletPoolSize);
+    }
+}
+
+void AWeaponBase::LoadCosmetics()
+{
+    // Dedicated servers never play the weapon's cosmetics, so they never load them either
+    if (!FPSCore::ShouldPlayCosmetics(this))
+    {
+        return;
+    }
+
+    // Loading in the background, so that weapons spawned during a match do not stall the game thread. Anything that was
+    // requested for previous weapon data is let go of once the new request holds on to what it still needs
+    TArray<FSoftObjectPath> CosmeticPaths;
+    auto Load = [&CosmeticPaths](const auto &Asset)
+    {
+        if (!Asset.IsNull())
+        {
+            CosmeticPaths.AddUnique(Asset.ToSoftObjectPath());
+        }
+    };
+
+    Load(WeaponData.MuzzleFlash);
+    Load(WeaponData.BulletTrace);
+    Load(EjectedCasing);
+    Load(WeaponData.FireSound);
+    Load(WeaponData.SilencedSound);
+    Load(WeaponData.EmptyFireSound);
+    Load(WeaponData.FireLoopSound);
+    Load(WeaponData.FireStartSound);
+    Load(WeaponData.FireTailSound);
+
+    // The hit effects of the legacy surface fields have been copied into the surface responses
+    for (const FSurfaceResponse &Response : SurfaceResponses)
+    {
+        Load(Response.ImpactEffect);
+        Load(Response.BatchedImpactEffect);
+        Load(Response.ImpactSound);
+    }
+
+    const TSharedPtr<FStreamableHandle> PreviousHandle = CosmeticsHandle;
+    CosmeticsHandle = CosmeticPaths.Num() > 0 ? UAssetManager::GetStreamableManager().RequestAsyncLoad(CosmeticPaths, FStreamableDelegate::CreateUObject(this, &AWeaponBase::OnCosmeticsLoaded)) : nullptr;
+    if (PreviousHandle.IsValid())
+    {
+        PreviousHandle->CancelHandle();
+    }
+}
+
+void AWeaponBase::OnCosmeticsLoaded()
+{
+    PrewarmEffects();
+}
+
+void AWeaponBase::BuildSurfaceResponses()
+{
+    // Every surface type starts with the default hit effect
+    FSurfaceResponse DefaultResponse;
+    DefaultResponse.ImpactEffect = WeaponData.DefaultHitEffect;
+    SurfaceResponses.Init(DefaultResponse, SurfaceType_Max);
+    UntypedSurfaceResponses.Reset();
+
+    // Mapping the legacy surface fields through their surface type, so that weapons without a table keep working.
+    // Materials without a surface type are matched by material instead, through responses of their own after the
+    // surface types. Every machine builds them in the same order, so their indices can be replicated like surface types
+    auto ApplyLegacySurface = [this](const UPhysicalMaterial *Surface, const TSoftObjectPtr<UNiagaraSystem> &ImpactEffect, const float DamageMultiplier)
+    {
+        if (!Surface)
         {
-            VerticalRecoilTimeline.Stop();
-            HorizontalRecoilTimeline.Stop();
-            Client_RecoilRecovery();
+            return;
         }
 
-        if (!WeaponData.bIsShotgun)
+        int32 ResponseIndex = Surface->SurfaceType;
+        if (Surface->SurfaceType == SurfaceType_Default)
         {
-            if (WeaponData.Gun_Shot)
+            const int32 *UntypedIndex = UntypedSurfaceResponses.Find(Surface);
+            ResponseIndex = UntypedIndex ? *UntypedIndex : UntypedSurfaceResponses.Add(Surface, SurfaceResponses.AddDefaulted());
+        }
+
+        FSurfaceResponse &Response = SurfaceResponses[ResponseIndex];
+        Response.Surface = Surface->SurfaceType;
+        Response.ImpactEffect = ImpactEffect;
+        Response.DamageMultiplier = DamageMultiplier;
+    };
+    ApplyLegacySurface(WeaponData.RockSurface, WeaponData.RockHitEffect, 1.0f);
+    ApplyLegacySurface(WeaponData.GroundSurface, WeaponData.GroundHitEffect, 1.0f);
+    ApplyLegacySurface(WeaponData.NormalDamageSurface, WeaponData.EnemyHitEffect, 1.0f);
+    ApplyLegacySurface(WeaponData.HeadshotDamageSurface, WeaponData.EnemyHitEffect, WeaponData.HeadshotMultiplier);
+
+    // Rows of the surface response table take priority over the legacy fields
+    if (WeaponData.SurfaceResponseTable)
+    {
+        WeaponData.SurfaceResponseTable->ForeachRow<FSurfaceResponse>(TEXT("BuildSurfaceResponses"), [this](const FName &Key, const FSurfaceResponse &Row)
+        {
+            SurfaceResponses[Row.Surface] = Row;
+        });
+    }
+}
+
+int32 AWeaponBase::GetSurfaceResponseIndex(const UPhysicalMaterial *PhysMaterial) const
+{
+    if (const int32 *UntypedIndex = PhysMaterial ? UntypedSurfaceResponses.Find(PhysMaterial) : nullptr)
+    {
+        return *UntypedIndex;
+    }
+    return UPhysicalMaterial::DetermineSurfaceType(PhysMaterial);
+}
+
+const FSurfaceResponse &AWeaponBase::GetSurfaceResponse(const int32 ResponseIndex) const
+{
+    static const FSurfaceResponse DefaultResponse;
+    return SurfaceResponses.IsValidIndex(ResponseIndex) ? SurfaceResponses[ResponseIndex] : DefaultResponse;
+}
+
+void AWeaponBase::SetStaticWeaponData(const FStaticWeaponData NewWeaponData)
+{
+    WeaponData = NewWeaponData;
+
+    // The surface responses and cosmetics come from the weapon data, and would otherwise keep following the old data.
+    // BeginPlay sets both up for weapons which have not begun play yet
+    if (HasActorBegunPlay())
+    {
+        BuildSurfaceResponses();
+        LoadCosmetics();
+    }
+}
+
+void AWeaponBase::CycleShot()
+{
+    if (!WeaponData.bAutomaticFire)
+    {
+        if (IsOwnerLocallyControlled())
+        {
+            RecoilRecovery();
+        }
+    }
+
+    if (!WeaponData.bIsShotgun)
+    {
+        if (WeaponData.Gun_Shot)
+        {
+            if (WeaponData.bWaitForAnim)
+            {
+                // Preventing the player from firing the weapon until the animation finishes playing
+                const float AnimWaitTime = ActionDurations.ShotCycle;
+                bCanFire = false;
+                // Reset the timer handle
+                GetWorldTimerManager().ClearTimer(AnimationWaitDelay);
+                GetWorldTimerManager().SetTimer(AnimationWaitDelay, this, &AWeaponBase::EnableFire, AnimWaitTime, false, AnimWaitTime);
+            }
+        }
+    }
+    else
+    {
+        if (WeaponData.Gun_Shot)
+        {
+            if (!ShotGunFiredFirstShot)
             {
                 if (WeaponData.bWaitForAnim)
                 {
                     // Preventing the player from firing the weapon until the animation finishes playing
-                    const float AnimWaitTime = WeaponData.Gun_Shot->GetPlayLength();
+                    const float AnimWaitTime = ActionDurations.ShotCycle;
                     bCanFire = false;
                     // Reset the timer handle
                     GetWorldTimerManager().ClearTimer(AnimationWaitDelay);
                     GetWorldTimerManager().SetTimer(AnimationWaitDelay, this, &AWeaponBase::EnableFire, AnimWaitTime, false, AnimWaitTime);
                 }
+                ShotGunFiredFirstShot = true;
             }
-        }
-        else
-        {
-            if (WeaponData.Gun_Shot)
+            else
             {
-                if (!ShotGunFiredFirstShot)
-                {
-                    if (WeaponData.bWaitForAnim)
-                    {
-                        // Preventing the player from firing the weapon until the animation finishes playing
-                        const float AnimWaitTime = WeaponData.Gun_Shot->GetPlayLength();
-                        bCanFire = false;
-                        // Reset the timer handle
-                        GetWorldTimerManager().ClearTimer(AnimationWaitDelay);
-                        GetWorldTimerManager().SetTimer(AnimationWaitDelay, this, &AWeaponBase::EnableFire, AnimWaitTime, false, AnimWaitTime);
-                    }
-                    ShotGunFiredFirstShot = true;
-                }
-                else
+                if (WeaponData.bWaitForAnim)
                 {
-                    if (WeaponData.bWaitForAnim)
-                    {
-                        // Preventing the player from firing the weapon until the animation finishes playing
-                        const float AnimWaitTime = WeaponData.ShotGun_Shot2->GetPlayLength();
-                        bCanFire = false;
-                        // Reset the timer handle
-                        GetWorldTimerManager().ClearTimer(AnimationWaitDelay);
-                        GetWorldTimerManager().SetTimer(AnimationWaitDelay, this, &AWeaponBase::EnableFire, AnimWaitTime, false, AnimWaitTime);
-                    }
-                    ShotGunFiredFirstShot = false;
+                    // Preventing the player from firing the weapon until the animation finishes playing
+                    const float AnimWaitTime = ActionDurations.AlternateShotCycle;
+                    bCanFire = false;
+                    // Reset the timer handle
+                    GetWorldTimerManager().ClearTimer(AnimationWaitDelay);
+                    GetWorldTimerManager().SetTimer(AnimationWaitDelay, this, &AWeaponBase::EnableFire, AnimWaitTime, false, AnimWaitTime);
                 }
+                ShotGunFiredFirstShot = false;
             }
         }
-        bHasFiredRecently = true;
-    }
-    else if (bCanFire && !bIsReloading)
-    {
-        Multi_Fire_NoBullets();
     }
+    bHasFiredRecently = true;
 }
 
-bool AWeaponBase::Multi_Fire_Validate(FHitResult HitResult)
+bool AWeaponBase::Multi_Fire_Validate(const FWeaponImpactBatch &ImpactBatch)
 {
     return true;
 }
-void AWeaponBase::Multi_Fire_Implementation(FHitResult HitResult)
+void AWeaponBase::Multi_Fire_Implementation(const FWeaponImpactBatch &ImpactBatch)
 {
-    FRotator EjectionSpawnVector = FRotator::ZeroRotator;
-    EjectionSpawnVector.Yaw = 270.0f;
-    UNiagaraFunctionLibrary::SpawnSystemAttached(EjectedCasing, MagazineAttachment, FName("ejection_port"), FVector::ZeroVector, EjectionSpawnVector, EAttachLocation::SnapToTarget, true, true);
-
-    EndPoint = HitResult.Location;
-
-    const FRotator ParticleRotation = (EndPoint - (WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation))).Rotation();
-
-    // Spawning the bullet trace particle effect
-    if (WeaponData.bHasAttachments)
+    // The owning client has already played this shot when predicting it, and dedicated servers have nobody to show it to
+    if (!IsLocallyPredicting() && FPSCore::ShouldPlayCosmetics(this))
     {
-        UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.BulletTrace, BarrelAttachment->GetSocketLocation(WeaponData.ParticleSpawnLocation), ParticleRotation);
+        PlayImpactEffects(ImpactBatch);
     }
-    else
+}
+
+void AWeaponBase::PlayImpactEffects(const FWeaponImpactBatch &ImpactBatch)
+{
+    // Dedicated servers have nobody to show the shot to, and do not have an effect pool
+    UWeaponEffectPoolSubsystem *EffectPool = GetWorld()->GetSubsystem<UWeaponEffectPoolSubsystem>();
+    if (!EffectPool)
     {
-        UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.BulletTrace, MeshComp->GetSocketLocation(WeaponData.ParticleSpawnLocation), ParticleRotation);
+        return;
     }
 
-    // Selecting the hit effect based on the hit physical surface material (hit.PhysMaterial.Get()) and spawning it (Niagara)
+    // Cosmetics of insignificant weapons are dropped or simplified when the frame's effect budget runs low
+    UWeaponSignificanceSubsystem *Significance = GetWorld()->GetSubsystem<UWeaponSignificanceSubsystem>();
+    const bool bSimplifyEffects = Significance && Significance->ShouldSimplifyEffects(this);
 
-    if (HitResult.PhysMaterial.Get() == WeaponData.NormalDamageSurface || HitResult.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
+    // Ejecting a single casing per shot, no matter how many pellets were fired
+    if (!Significance || Significance->ConsumeEffectBudget(this, EWeaponCosmetic::Casing))
     {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.EnemyHitEffect, HitResult.GetComponent(), "", HitResult.ImpactPoint, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition, false);
+        FRotator EjectionSpawnVector = FRotator::ZeroRotator;
+        EjectionSpawnVector.Yaw = 270.0f;
+        EffectPool->SpawnEffectAttached(EjectedCasing.Get(), MagazineAttachment, FName("ejection_port"), FVector::ZeroVector, EjectionSpawnVector, EAttachLocation::SnapToTarget);
     }
 
-    else if (HitResult.PhysMaterial.Get() == WeaponData.GroundSurface)
-    {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.GroundHitEffect, HitResult.GetComponent(), "", HitResult.ImpactPoint, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition, false);
-    }
-    else if (HitResult.PhysMaterial.Get() == WeaponData.RockSurface)
-    {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.RockHitEffect, HitResult.GetComponent(), "", HitResult.ImpactPoint, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition, false);
-    }
-    else
+    const FVector MuzzleLocation = WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation);
+    const FVector TraceSpawnLocation = WeaponData.bHasAttachments ? BarrelAttachment->GetSocketLocation(WeaponData.ParticleSpawnLocation) : MeshComp->GetSocketLocation(WeaponData.ParticleSpawnLocation);
+
+    // Rebuilding the direction of every pellet from the shot's seed, exactly as the server traced them
+    const int NumberOfShots = GetNumPellets();
+    const float Range = GetShotRange();
+
+    UProjectileSubsystem *Projectiles = WeaponData.bUseProjectiles ? GetWorld()->GetSubsystem<UProjectileSubsystem>() : nullptr;
+
+    // Impacts are sorted by pellet index, so we walk through them alongside the pellets
+    int32 ImpactIndex = 0;
+
+    for (int i = 0; i < NumberOfShots; i++)
     {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.DefaultHitEffect, HitResult.GetComponent(), "", HitResult.ImpactPoint, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition, false);
+        const FVector PelletDirection = GetPelletRotation(ImpactBatch, i).Vector();
+
+        const FWeaponImpact *Impact = nullptr;
+        if (ImpactBatch.Impacts.IsValidIndex(ImpactIndex) && ImpactBatch.Impacts[ImpactIndex].PelletIndex == i)
+        {
+            Impact = &ImpactBatch.Impacts[ImpactIndex++];
+        }
+
+        EndPoint = ImpactBatch.Origin + PelletDirection * (Impact ? Impact->Distance : Range);
+
+        const FRotator ParticleRotation = (EndPoint - MuzzleLocation).Rotation();
+
+        // Spawning the bullet trace particle effect, only for the first pellet of simplified shots
+        if ((i == 0 || !bSimplifyEffects) && (!Significance || Significance->ConsumeEffectBudget(this, EWeaponCosmetic::Tracer)))
+        {
+            EffectPool->SpawnEffectAtLocation(WeaponData.BulletTrace.Get(), TraceSpawnLocation, ParticleRotation);
+        }
+
+        // Simulating a cosmetic projectile, which spawns its own impact effect. The server already simulates the real one
+        if (WeaponData.bUseProjectiles)
+        {
+            if (Projectiles && !HasAuthority())
+            {
+                Projectiles->SpawnProjectile(this, ImpactBatch.Origin, PelletDirection * WeaponData.MuzzleVelocity, WeaponData.ProjectileGravityScale, WeaponData.ProjectileDrag, WeaponData.ProjectileLifetime, false);
+            }
+            continue;
+        }
+
+        if (!Impact)
+        {
+            continue;
+        }
+
+        // Spawning the hit effect and sound for the hit surface type (Niagara). The surface normal is not replicated, so
+        // impacts face back along the pellet
+        PlaySurfaceImpact(GetSurfaceResponse(Impact->SurfaceResponse), Impact->HitComponent, EndPoint, -PelletDirection);
     }
 }
 
@@ -597,6 +1266,28 @@ bool AWeaponBase::Multi_FireOnce_Validate()
 }
 void AWeaponBase::Multi_FireOnce_Implementation()
 {
+    if (!IsLocallyPredicting())
+    {
+        PlayFireEffects();
+    }
+}
+
+void AWeaponBase::PlayFireEffects()
+{
+    AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
+
+    // The third person montage moves the hitboxes that shots are checked against, so it is played by the server too
+    if (WeaponData.Player_Shot && PlayerCharacter)
+    {
+        AnimTime = FPSCore::PlayMontage(PlayerCharacter->GetThirdPersonMesh(), WeaponData.Player_Shot);
+    }
+
+    // Everything else is only ever seen or heard by players
+    if (!FPSCore::ShouldPlayCosmetics(this))
+    {
+        return;
+    }
+
     // Playing an animation on the weapon mesh
     if (!WeaponData.bIsShotgun)
     {
@@ -625,32 +1316,23 @@ void AWeaponBase::Multi_FireOnce_Implementation()
         }
     }
 
-    if (WeaponData.Player_Shot)
+    if (WeaponData.Player_Shot && PlayerCharacter)
     {
-        if (AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner()))
-        {
-            AnimTime = PlayerCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(WeaponData.Player_Shot, 1.0f);
-            AnimTime = PlayerCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(WeaponData.Player_Shot, 1.0f);
-        }
+        FPSCore::PlayMontage(PlayerCharacter->GetHandsMesh(), WeaponData.Player_Shot);
     }
 
-    if (WeaponData.bHasAttachments)
-    {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.MuzzleFlash, BarrelAttachment, WeaponData.ParticleSpawnLocation, FVector::ZeroVector, BarrelAttachment->GetSocketRotation(WeaponData.ParticleSpawnLocation), EAttachLocation::SnapToTarget, true);
-    }
-    else
+    UWeaponEffectPoolSubsystem *EffectPool = GetWorld()->GetSubsystem<UWeaponEffectPoolSubsystem>();
+    UWeaponSignificanceSubsystem *Significance = GetWorld()->GetSubsystem<UWeaponSignificanceSubsystem>();
+    if (EffectPool && (!Significance || Significance->ConsumeEffectBudget(this, EWeaponCosmetic::MuzzleFlash)))
     {
-        UNiagaraFunctionLibrary::SpawnSystemAttached(WeaponData.MuzzleFlash, MeshComp, WeaponData.ParticleSpawnLocation, FVector::ZeroVector, MeshComp->GetSocketRotation(WeaponData.ParticleSpawnLocation), EAttachLocation::SnapToTarget, true);
+        USceneComponent *MuzzleComponent = WeaponData.bHasAttachments ? BarrelAttachment : MeshComp;
+        EffectPool->SpawnEffectAttached(WeaponData.MuzzleFlash.Get(), MuzzleComponent, WeaponData.ParticleSpawnLocation, FVector::ZeroVector, MuzzleComponent->GetSocketRotation(WeaponData.ParticleSpawnLocation), EAttachLocation::SnapToTarget);
     }
 
     // Spawning the firing sound
-    if (WeaponData.bSilenced)
+    if (UWeaponAudioSubsystem *WeaponAudio = GetWorld()->GetSubsystem<UWeaponAudioSubsystem>())
     {
-        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.SilencedSound, MeshComp->GetSocketLocation(WeaponData.MuzzleLocation));
-    }
-    else
-    {
-        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.FireSound, MeshComp->GetSocketLocation(WeaponData.MuzzleLocation));
+        WeaponAudio->PlayFireSound(this, GetSoundSourceComponent(), WeaponData.MuzzleLocation);
     }
 }
 
@@ -660,9 +1342,20 @@ bool AWeaponBase::Multi_Fire_NoBullets_Validate()
 }
 void AWeaponBase::Multi_Fire_NoBullets_Implementation()
 {
-    UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.EmptyFireSound, MeshComp->GetSocketLocation(WeaponData.MuzzleLocation));
-    // Clearing the ShotDelay timer so that we don't have a constant ticking when the player has no ammo, just a single click
-    GetWorldTimerManager().ClearTimer(ShotDelay);
+    if (!IsLocallyPredicting())
+    {
+        PlayEmptyFireEffects();
+    }
+}
+
+void AWeaponBase::PlayEmptyFireEffects()
+{
+    if (UWeaponAudioSubsystem *WeaponAudio = GetWorld()->GetSubsystem<UWeaponAudioSubsystem>())
+    {
+        WeaponAudio->PlayWeaponSound(this, WeaponData.EmptyFireSound.Get(), GetSoundSourceComponent()->GetSocketLocation(WeaponData.MuzzleLocation));
+    }
+    // Stopping the fire scheduler so that we don't have a constant ticking when the player has no ammo, just a single click
+    bTriggerHeld = false;
 }
 
 void AWeaponBase::Recoil()
@@ -670,16 +1363,15 @@ void AWeaponBase::Recoil()
     AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
     AFPSCharacterController *CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
 
-    // Apply recoil by adding a pitch and yaw input to the character controller
-    if (WeaponData.bAutomaticFire && CharacterController && ShotsFired > 0 && IsValid(WeaponData.VerticalRecoilCurve) && IsValid(WeaponData.HorizontalRecoilCurve))
-    {
-        CharacterController->AddPitchInput(WeaponData.VerticalRecoilCurve->GetFloatValue(VerticalRecoilTimeline.GetPlaybackPosition()) * VerticalRecoilModifier);
-        CharacterController->AddYawInput(WeaponData.HorizontalRecoilCurve->GetFloatValue(HorizontalRecoilTimeline.GetPlaybackPosition()) * HorizontalRecoilModifier);
-    }
-    else if (CharacterController && ShotsFired <= 0 && IsValid(WeaponData.VerticalRecoilCurve) && IsValid(WeaponData.HorizontalRecoilCurve))
+    // Apply recoil by adding a pitch and yaw input to the character controller. Shots are fired a fixed interval apart,
+    // so the recoil of a shot is looked up from its index within the burst (manual weapons only recoil on their first shot)
+    if (CharacterController && RecoilTable.IsValid() && (WeaponData.bAutomaticFire || ShotsFired <= 0))
     {
-        CharacterController->AddPitchInput(WeaponData.VerticalRecoilCurve->GetFloatValue(0) * VerticalRecoilModifier);
-        CharacterController->AddYawInput(WeaponData.HorizontalRecoilCurve->GetFloatValue(0) * HorizontalRecoilModifier);
+        float RecoilPitch;
+        float RecoilYaw;
+        RecoilTable.EvaluateShot(ShotsFired, RecoilPitch, RecoilYaw);
+        CharacterController->AddPitchInput(RecoilPitch);
+        CharacterController->AddYawInput(RecoilYaw);
     }
 
     ShotsFired += 1;
@@ -689,33 +1381,54 @@ void AWeaponBase::Recoil()
     }
 }
 
-bool AWeaponBase::Client_Recoil_Validate()
+void AWeaponBase::RecoilRecovery()
 {
-    return true;
+    // Starts playing the recovery curve, which is followed in Tick
+    if (bShouldRecover && RecoveryCurve)
+    {
+        RecoveryStartTime = GetWorld()->GetTimeSeconds();
+        bIsRecovering = true;
+        UpdateTickEnabled();
+    }
 }
 
-void AWeaponBase::Client_Recoil_Implementation()
+void AWeaponBase::UpdateRecoilRecovery()
 {
-    Recoil();
-}
+    const float RecoveryTime = GetWorld()->GetTimeSeconds() - RecoveryStartTime;
+    HandleRecoveryProgress(RecoveryTable.Evaluate(RecoveryTime));
 
-void AWeaponBase::RecoilRecovery()
-{
-    // Plays the recovery timeline
-    if (bShouldRecover)
+    if (RecoveryTime >= RecoveryTable.GetEndTime())
     {
-        RecoilRecoveryTimeline.PlayFromStart();
+        bIsRecovering = false;
     }
 }
 
-bool AWeaponBase::Client_RecoilRecovery_Validate()
+void AWeaponBase::BakeRecoil()
 {
-    return true;
+    // Attachments may have replaced the recoil curves and rate of fire, and scaled the recoil, since the last bake
+    RecoilTable.Bake(WeaponData.VerticalRecoilCurve, WeaponData.HorizontalRecoilCurve, VerticalRecoilModifier, HorizontalRecoilModifier, WeaponData.RateOfFire);
+    RecoveryTable.Bake(RecoveryCurve);
 }
 
-void AWeaponBase::Client_RecoilRecovery_Implementation()
+void AWeaponBase::BakeActionDurations()
 {
-    RecoilRecovery();
+    // Durations set in WeaponData take priority, the rest are read from the length of the animation that they play along
+    auto Bake = [](const float DataDuration, const UAnimSequenceBase *Animation, const float FallbackDuration)
+    {
+        if (DataDuration > 0.0f)
+        {
+            return DataDuration;
+        }
+        return Animation ? Animation->GetPlayLength() : FallbackDuration;
+    };
+
+    const FWeaponActionDurations &DataDurations = WeaponData.ActionDurations;
+    ActionDurations.Reload = Bake(DataDurations.Reload, WeaponData.PlayerReload, DefaultReloadDuration);
+    ActionDurations.EmptyReload = Bake(DataDurations.EmptyReload, WeaponData.EmptyPlayerReload, ActionDurations.Reload);
+    ActionDurations.ShotCycle = Bake(DataDurations.ShotCycle, WeaponData.Gun_Shot, 0.0f);
+    ActionDurations.AlternateShotCycle = Bake(DataDurations.AlternateShotCycle, WeaponData.ShotGun_Shot2, ActionDurations.ShotCycle);
+    ActionDurations.Equip = Bake(DataDurations.Equip, WeaponEquip, 0.0f);
+    ActionDurations.Unequip = Bake(DataDurations.Unequip, WeaponData.WeaponUnequip, 0.0f);
 }
 
 bool AWeaponBase::Reload()
@@ -742,15 +1455,9 @@ bool AWeaponBase::Reload()
         if (!bIsReloading && CharacterController->AmmoMap[GeneralWeaponData.AmmoType] > 0 && (GeneralWeaponData.ClipSize != (GeneralWeaponData.ClipCapacity + Value)))
         {
             Multi_Reload();
-            if (WeaponData.PlayerReload || WeaponData.EmptyPlayerReload)
-            {
-                AnimTime = PlayerCharacter->GetHandsMesh()->GetAnimInstance()->GetCurrentActiveMontage()->GetPlayLength();
-                AnimTime = PlayerCharacter->GetThirdPersonMesh()->GetAnimInstance()->GetCurrentActiveMontage()->GetPlayLength();
-            }
-            else
-            {
-                AnimTime = 2.0f;
-            }
+
+            // Timing the reload from its baked duration, matching the montage chosen by Multi_Reload
+            AnimTime = GeneralWeaponData.ClipSize <= 0 && WeaponData.EmptyPlayerReload ? ActionDurations.EmptyReload : ActionDurations.Reload;
 
             // Printing debug strings
             if (bShowDebug)
@@ -761,6 +1468,7 @@ bool AWeaponBase::Reload()
             // Setting variables to make sure that the player cannot fire or reload during the time that the weapon is in it's reloading animation
             bCanFire = false;
             bIsReloading = true;
+            ConfirmShotState();
 
             // Starting the timer alongside the animation of the weapon reloading, casting to UpdateAmmo when it finishes
             GetWorldTimerManager().SetTimer(ReloadingDelay, this, &AWeaponBase::UpdateAmmo, AnimTime, false, AnimTime);
@@ -778,35 +1486,44 @@ void AWeaponBase::Multi_Reload_Implementation()
 {
     AFPSCharacter *PlayerCharacter = Cast<AFPSCharacter>(GetOwner());
 
+    // Weapon and first person animations are only played for players, the third person montage moves the hitboxes
+    const bool bPlayCosmetics = FPSCore::ShouldPlayCosmetics(this);
+
     // Differentiating between having no ammunition in the magazine (having to chamber a round after reloading)
     // or not, and playing an animation relevant to that
     if (GeneralWeaponData.ClipSize <= 0 && WeaponData.EmptyPlayerReload)
     {
-        if (WeaponData.bHasAttachments)
-        {
-            MagazineAttachment->PlayAnimation(WeaponData.EmptyWeaponReload, false);
-        }
-        else
+        if (bPlayCosmetics)
         {
-            MeshComp->PlayAnimation(WeaponData.EmptyWeaponReload, false);
-            TPMeshComp->PlayAnimation(WeaponData.EmptyWeaponReload, false);
+            if (WeaponData.bHasAttachments)
+            {
+                MagazineAttachment->PlayAnimation(WeaponData.EmptyWeaponReload, false);
+            }
+            else
+            {
+                MeshComp->PlayAnimation(WeaponData.EmptyWeaponReload, false);
+                TPMeshComp->PlayAnimation(WeaponData.EmptyWeaponReload, false);
+            }
+            FPSCore::PlayMontage(PlayerCharacter->GetHandsMesh(), WeaponData.EmptyPlayerReload);
         }
-        PlayerCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(WeaponData.EmptyPlayerReload, 1.0f);
-        PlayerCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(WeaponData.EmptyPlayerReload, 1.0f);
+        FPSCore::PlayMontage(PlayerCharacter->GetThirdPersonMesh(), WeaponData.EmptyPlayerReload);
     }
     else if (WeaponData.PlayerReload)
     {
-        if (WeaponData.bHasAttachments)
-        {
-            MagazineAttachment->GetAnimInstance()->Montage_Play(WeaponData.WeaponReload, 1.0f);
-        }
-        else
+        if (bPlayCosmetics)
         {
-            MeshComp->PlayAnimation(WeaponData.WeaponReload, false);
-            TPMeshComp->PlayAnimation(WeaponData.WeaponReload, false);
+            if (WeaponData.bHasAttachments)
+            {
+                FPSCore::PlayMontage(MagazineAttachment, WeaponData.WeaponReload);
+            }
+            else
+            {
+                MeshComp->PlayAnimation(WeaponData.WeaponReload, false);
+                TPMeshComp->PlayAnimation(WeaponData.WeaponReload, false);
+            }
+            FPSCore::PlayMontage(PlayerCharacter->GetHandsMesh(), WeaponData.PlayerReload);
         }
-        PlayerCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(WeaponData.PlayerReload, 1.0f);
-        PlayerCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(WeaponData.PlayerReload, 1.0f);
+        FPSCore::PlayMontage(PlayerCharacter->GetThirdPersonMesh(), WeaponData.PlayerReload);
     }
 }
 
@@ -819,8 +1536,11 @@ void AWeaponBase::Multi_SwapWeaponAnim_Implementation()
         {
             UAnimMontage *EquipMontage = GetStaticWeaponData()->WeaponEquip;
             // Play the second animation
-            FPSCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(EquipMontage, 1.0f);
-            FPSCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(EquipMontage, 1.0f);
+            FPSCore::PlayMontage(FPSCharacter->GetThirdPersonMesh(), EquipMontage);
+            if (FPSCore::ShouldPlayCosmetics(this))
+            {
+                FPSCore::PlayMontage(FPSCharacter->GetHandsMesh(), EquipMontage);
+            }
         }
     }
 }
@@ -834,7 +1554,7 @@ void AWeaponBase::Multi_UnequipWeaponAnim_Implementation()
         {
             UAnimMontage *UnequipMontage = GetStaticWeaponData()->WeaponUnequip;
             // Play the second animation
-            FPSCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(UnequipMontage, 1.0f);
+            FPSCore::PlayMontage(FPSCharacter->GetThirdPersonMesh(), UnequipMontage);
         }
     }
 }
@@ -846,8 +1566,13 @@ void AWeaponBase::HandleUnequip_Implementation(UInventoryComponent *InventoryCom
         if (const AFPSCharacter *FPSCharacter = Cast<AFPSCharacter>(GetOwner()))
         {
             FTimerHandle WeaponSwapDelegate;
-            const float UnequipAnimTime = FPSCharacter->GetHandsMesh()->GetAnimInstance()->Montage_Play(GetStaticWeaponData()->WeaponUnequip, 1.0f);
-            FPSCharacter->GetThirdPersonMesh()->GetAnimInstance()->Montage_Play(GetStaticWeaponData()->WeaponUnequip, 1.0f);
+            // Timing the swap from its baked duration rather than from the montage
+            const float UnequipAnimTime = ActionDurations.Unequip;
+            FPSCore::PlayMontage(FPSCharacter->GetThirdPersonMesh(), GetStaticWeaponData()->WeaponUnequip);
+            if (FPSCore::ShouldPlayCosmetics(this))
+            {
+                FPSCore::PlayMontage(FPSCharacter->GetHandsMesh(), GetStaticWeaponData()->WeaponUnequip);
+            }
             Multi_UnequipWeaponAnim();
             FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(InventoryComponent, &UInventoryComponent::UnequipReturn);
             GetWorld()->GetTimerManager().SetTimer(WeaponSwapDelegate, TimerDelegate, UnequipAnimTime, false, UnequipAnimTime);
@@ -855,6 +1580,17 @@ void AWeaponBase::HandleUnequip_Implementation(UInventoryComponent *InventoryCom
     }
 }
 
+void AWeaponBase::HandleEquip_Implementation()
+{
+    // Timing the equip from its baked duration rather than from the montage, which may be cosmetic only
+    if (ActionDurations.Equip > 0.0f)
+    {
+        GetWorldTimerManager().ClearTimer(SpamFirePreventionDelay);
+        bIsWeaponReadyToFire = false;
+        GetWorldTimerManager().SetTimer(EquipDelay, this, &AWeaponBase::ReadyToFire, ActionDurations.Equip, false, ActionDurations.Equip);
+    }
+}
+
 void AWeaponBase::UpdateAmmo()
 {
     // Printing debug strings
@@ -908,6 +1644,7 @@ void AWeaponBase::UpdateAmmo()
 
     // Resetting bIsReloading and allowing the player to fire the gun again
     bIsReloading = false;
+    ConfirmShotState();
 
     // Making sure the player cannot fire if sliding
     if (!(PlayerCharacter->GetMovementState() == EMovementState::State_Slide))
@@ -922,16 +1659,28 @@ void AWeaponBase::UpdateAmmo()
     bIsWeaponReadyToFire = true;
 }
 
-// Called every frame
+void AWeaponBase::UpdateTickEnabled()
+{
+    SetActorTickEnabled(!bIsHolstered && (bTriggerHeld || bIsRecovering || bShowDebug));
+}
+
+// Called every frame while the weapon is firing or recovering from recoil
 void AWeaponBase::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
 
-    VerticalRecoilTimeline.TickTimeline(DeltaTime);
-    HorizontalRecoilTimeline.TickTimeline(DeltaTime);
-    RecoilRecoveryTimeline.TickTimeline(DeltaTime);
+    if (bIsRecovering)
+    {
+        UpdateRecoilRecovery();
+    }
 
-    SetTPAttachment();
+    if (bTriggerHeld)
+    {
+        FVector AimLocation;
+        FRotator AimRotation;
+        GetCurrentAim(AimLocation, AimRotation);
+        RunFireScheduler(DeltaTime, AimLocation, AimRotation.Quaternion());
+    }
 
     if (bShowDebug)
     {
@@ -939,6 +1688,9 @@ void AWeaponBase::Tick(float DeltaTime)
         GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Green, bCanFire ? TEXT("Can Fire") : TEXT("Can not Fire"));
         GEngine->AddOnScreenDebugMessage(-1, DeltaTime, FColor::Green, bIsWeaponReadyToFire ? TEXT("Weapon is ready to fire") : TEXT("Weapon is not ready to fire"));
     }
+
+    // Unregistering our tick once the trigger has been released and the recovery is over
+    UpdateTickEnabled();
 }
 
 // Recovering the player's recoil to the pre-fired position
@@ -953,13 +1705,3 @@ void AWeaponBase::HandleRecoveryProgress(float Value) const
 
     CharacterController->SetControlRotation(NewControlRotation);
 }
-
-bool AWeaponBase::Client_HandleRecoveryProgress_Validate(float Value) const
-{
-    return true;
-}
-
-void AWeaponBase::Client_HandleRecoveryProgress_Implementation(float Value) const
-{
-    HandleRecoveryProgress(Value);
-}
\ No newline at end of file
@@ -43,6 +43,14 @@ void AWeaponPickup::BeginPlay()
 	if (!bStatic)
 	{
 		MeshComp->SetSimulatePhysics(true);
+
+		// Pickups that simulate physics only go dormant while they are at rest
+		if (HasAuthority())
+		{
+			MeshComp->BodyInstance.bGenerateWakeEvents = true;
+			MeshComp->OnComponentSleep.AddDynamic(this, &AWeaponPickup::OnMeshSleep);
+			MeshComp->OnComponentWake.AddDynamic(this, &AWeaponPickup::OnMeshWake);
+		}
 	}
 
 	InteractionText = WeaponName;
@@ -152,7 +160,23 @@ void AWeaponPickup::Interact()
 		// Spawning the new weapon in the player's inventory component
 		PlayerCharacter->GetInventoryComponent()->SpawnWeapon(WeaponReference, InventoryPosition, SpawnPickup, bStatic, GetActorTransform(), DataStruct);
 
-		// Destroying the pickup
+		// Destroying the pickup, waking it up first so that every connection is told
+		if (HasAuthority())
+		{
+			FlushNetDormancy();
+		}
 		Destroy();
 	}
+}
+
+void AWeaponPickup::OnMeshSleep(UPrimitiveComponent *SleepingComponent, FName BoneName)
+{
+	// Nothing left to replicate once the pickup has come to rest
+	SetNetDormancy(DORM_DormantAll);
+}
+
+void AWeaponPickup::OnMeshWake(UPrimitiveComponent *WakingComponent, FName BoneName)
+{
+	// Sending the pickup's movement again until it comes to rest
+	SetNetDormancy(DORM_Awake);
 }
\ No newline at end of file
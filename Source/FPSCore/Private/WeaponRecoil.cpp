@@ -0,0 +1,30 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "WeaponRecoil.h"
+#include "Curves/CurveFloat.h"
+
+void FBakedRecoilCurve::Bake(const UCurveFloat *Curve, const float Multiplier)
+{
+	if (!Curve)
+	{
+		*this = FBakedRecoilCurve();
+		return;
+	}
+
+	Curve->GetTimeRange(StartTime, EndTime);
+	const float SampleInterval = (EndTime - StartTime) / (NumSamples - 1);
+	InvSampleInterval = SampleInterval > 0.0f ? 1.0f / SampleInterval : 0.0f;
+
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		Samples[Index] = Curve->GetFloatValue(StartTime + Index * SampleInterval) * Multiplier;
+	}
+}
+
+void FWeaponRecoilTable::Bake(const UCurveFloat *VerticalCurve, const UCurveFloat *HorizontalCurve, const float VerticalMultiplier, const float HorizontalMultiplier, const float RateOfFire)
+{
+	Vertical.Bake(VerticalCurve, VerticalMultiplier);
+	Horizontal.Bake(HorizontalCurve, HorizontalMultiplier);
+	ShotInterval = RateOfFire > 0.0f ? 60.0f / RateOfFire : 0.0f;
+	bIsValid = VerticalCurve && HorizontalCurve;
+}
@@ -0,0 +1,126 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FPSCharacter.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "FPSCharacterMovementComponent.generated.h"
+
+/** Custom movement modes used by FPS characters */
+UENUM(BlueprintType)
+enum ECustomMovementMode
+{
+	CMOVE_None UMETA(Hidden),
+	CMOVE_Slide UMETA(DisplayName = "Slide"),
+	CMOVE_MAX UMETA(Hidden)
+};
+
+/** Character movement with predicted movement states.
+ *
+ *	The movement state requested by the owning client (sprint, walk, crouch, slide...) is packed into the custom
+ *	compressed flags of every saved move, so that the server performs each move with the same state the client
+ *	predicted it with, and corrects the client like any other movement error. No RPCs are needed to change state.
+ *	- Crouching and sliding use the engine's predicted crouch, which resizes the capsule as part of the move.
+ *	- Sliding is the CMOVE_Slide custom movement mode, which moves along the floor like walking.
+ *	- The speed, acceleration, braking and friction of every state are read from the character's MovementDataMap.
+ *	- Vaulting is a root motion source moving the character to the vault target, started by the first move requesting
+ *	  the vault state. The target is sent to the server once, ahead of that move, by AFPSCharacter::Server_Vault.
+ *	  Targets that the server refuses are dropped by the client through AFPSCharacter::Client_RejectVault.
+ *
+ *	Simulated proxies receive the movement mode and crouch through the character's replicated movement, and the
+ *	movement state through AFPSCharacter's replicated MovementState.
+ */
+UCLASS()
+class FPSCORE_API UFPSCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	/** Requests a new movement state, which is applied (and sent to the server) with the next move. Ignored during vaults,
+	 *	which the character leaves once they are over */
+	void SetRequestedMovementState(EMovementState NewMovementState);
+
+	/** Returns the movement state requested for the next move */
+	EMovementState GetRequestedMovementState() const { return RequestedMovementState; }
+
+	/** Sets the location that the next vault moves the character to. The vault starts with the next move requesting the
+	 *	vault state */
+	void SetVaultTarget(const FVector &TargetLocation);
+
+	/** Returns whether the character is currently being moved by a vault */
+	UFUNCTION(BlueprintPure, Category = "Character Movement")
+	bool IsVaulting() const;
+
+	/** Returns whether the character is still flying after the root motion of its vault has finished or been removed */
+	bool HasVaultEnded() const;
+
+	/** Stops predicting a vault that the server has refused, and forgets it in the moves that are replayed (owning client)
+	 *	@param TargetLocation The target of the refused vault, which is ignored if we have moved on to another vault since
+	 */
+	void CancelVault(const FVector &TargetLocation);
+
+	/** Returns whether the character is currently sliding */
+	UFUNCTION(BlueprintPure, Category = "Character Movement")
+	bool IsSliding() const { return MovementMode == MOVE_Custom && CustomMovementMode == CMOVE_Slide; }
+
+	/** UCharacterMovementComponent implementation */
+	virtual void SetUpdatedComponent(USceneComponent *NewUpdatedComponent) override;
+	virtual FNetworkPredictionData_Client *GetPredictionData_Client() const override;
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual bool ClientUpdatePositionAfterServerUpdate() override;
+	virtual bool IsMovingOnGround() const override;
+	virtual bool CanAttemptJump() const override;
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxBrakingDeceleration() const override;
+
+protected:
+	/** UCharacterMovementComponent implementation */
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual void OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) override;
+	virtual void PhysCustom(float DeltaTime, int32 Iterations) override;
+
+private:
+	/** Moves the character while sliding */
+	void PhysSlide(float DeltaTime, int32 Iterations);
+
+	/** Applies the movement data of a movement state, and lets the character know when the state has changed (unless
+	 *	moves are being replayed) */
+	void ApplyMovementState(EMovementState NewMovementState);
+
+	/** Starts moving the character to the vault target */
+	void StartVault();
+
+	/** Ends the vault once its root motion has finished */
+	void StopVault();
+
+	/** Lets the character know that the vault is over, or remembers it until moves have been replayed */
+	void FinishVault();
+
+	/** The name of the root motion source moving the character during vaults */
+	static const FName VaultRootMotionName;
+
+	/** The character that owns this component */
+	UPROPERTY(Transient, DuplicateTransient)
+	AFPSCharacter *FPSCharacterOwner;
+
+	/** The movement state requested for the next move, restored from the saved move when moves are replayed */
+	EMovementState RequestedMovementState = EMovementState::State_Idle;
+
+	/** The location that the next vault moves the character to */
+	FVector VaultTargetLocation = FVector::ZeroVector;
+
+	/** Whether a vault target has been set and not used by a vault yet */
+	bool bHasVaultTarget = false;
+
+	/** The latest movement state applied other than the vault, kept by moves requesting a vault which has not started */
+	EMovementState LastNonVaultMovementState = EMovementState::State_Idle;
+
+	/** The movement state of the last move replayed by ClientUpdatePositionAfterServerUpdate */
+	EMovementState ReplayedMovementState = EMovementState::State_Idle;
+
+	/** Whether a vault has ended while moves were being replayed */
+	bool bVaultFinishedDuringReplay = false;
+
+	friend class FSavedMove_FPSCharacter;
+};
@@ -11,14 +11,18 @@
 #include "Components/InventoryComponent.h"
 #include "Components/TimelineComponent.h"
 #include "GameFramework/Character.h"
+#include "WorldCollision.h"
 #include "FPSCharacter.generated.h"
 
 class UCameraComponent;
+class UFPSCharacterMovementComponent;
 class USkeletalMeshComponent;
 class AWeaponBase;
 class UAnimMontage;
 class UCurveFloat;
 class UBlendSpace;
+struct FVaultLedge;
+struct FVaultLedgeSettings;
 
 /** Movement state enumerator holding all possible movement states */
 UENUM(BlueprintType)
@@ -57,6 +61,42 @@ struct FMovementVariables
 	float MaxWalkSpeed;
 };
 
+/** The machines that a character tick task runs on */
+enum class ECharacterTickNetFilter : uint8
+{
+	/** Runs on every machine */
+	All,
+
+	/** Only runs on the machine controlling the character (the owning client, or the server for bots) */
+	LocallyControlled,
+
+	/** Only runs on the server */
+	Authority
+};
+
+/** A part of the character's per-frame work, run at its own rate, only on the machines that need it, and only while it has
+ *	something to update. The time spent in each task is shown by stat FPSCore */
+struct FCharacterTickTask
+{
+	/** Updates the task, given the time since it last ran */
+	TFunction<void(float)> Run;
+
+	/** Returns whether the task has anything to update. Tasks without one run whenever they are due */
+	TFunction<bool()> IsDirty;
+
+	/** The machines that the task runs on */
+	ECharacterTickNetFilter NetFilter = ECharacterTickNetFilter::All;
+
+	/** The time between two runs of the task, in seconds (0 to run every frame) */
+	float Interval = 0.0f;
+
+	/** The time since the task last ran */
+	float TimeSinceLastRun = 0.0f;
+
+	/** The cycle stat that the task's time is recorded in */
+	TStatId StatId;
+};
+
 UCLASS()
 class FPSCORE_API AFPSCharacter : public ACharacter
 {
@@ -153,6 +193,21 @@ public:
 	/** Returns the Inventory Component */
 	UInventoryComponent *GetInventoryComponent() const { return InventoryComponent; }
 
+	/** Returns the character's movement component */
+	UFPSCharacterMovementComponent *GetFPSCharacterMovement() const;
+
+	/** Returns the movement data of a movement state, or nullptr if it has not been set up in MovementDataMap */
+	const FMovementVariables *GetMovementData(const EMovementState State) const { return MovementDataMap.Find(State); }
+
+	/** Returns the curve that controls motion during vault */
+	UCurveFloat *GetVaultCurve() const { return VaultTimelineCurve; }
+
+	/** Returns the duration of a vault, in seconds */
+	float GetVaultDuration() const;
+
+	/** Returns the properties of the character that decide where it can vault or mantle to */
+	FVaultLedgeSettings GetVaultLedgeSettings() const;
+
 	UFUNCTION(BlueprintCallable, Category = "FPS Character")
 	void UpdateFOVOffset(const float NewOffset) { FOVOffset = NewOffset; }
 
@@ -162,11 +217,24 @@ public:
 		MovementDataMap[MovementStateToUpdate] = NewMovementVariables;
 	}
 
-	/** A global system that handles updates to the movement state and changes relevant values accordingly
+	/** Requests a new movement state. The request is predicted by the character movement component, which sends it to
+	 *	the server along with our moves, so this only has an effect on locally controlled characters
 	 *	@param NewMovementState The new movement state of the player
 	 */
 	void UpdateMovementState(EMovementState NewMovementState);
 
+	/** Sets the movement state and the flags and weapon restrictions that go with it. Called by the movement component
+	 *	when a move changes the movement state, use UpdateMovementState to request a new one
+	 *	@param NewMovementState The new movement state of the player
+	 */
+	void SetMovementState(EMovementState NewMovementState);
+
+	/** Applies the firing and reloading restrictions of the current movement state to the current weapon */
+	void UpdateWeaponMovementRestrictions();
+
+	/** Leaves the vault state. Called by the movement component once the vault's root motion has finished */
+	void OnVaultFinished();
+
 protected:
 	/** Calling Fire Function */
 	void Fire();
@@ -177,17 +245,22 @@ protected:
 	/** Calling Reload Function */
 	void Reload();
 
-	/** Calling RPC of firing function */
+	/** Calling RPC of firing function
+	 *	@param ClientTimestamp The client's estimate of the server time at which the shot was fired, used for lag compensation
+	 *	@param FirstShotId The ID of the first shot predicted by the client for this burst
+	 */
 	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_Fire(FVector CameraLocation, FRotator CameraRotation);
-	bool Server_Fire_Validate(FVector CameraLocation, FRotator CameraRotation);
-	void Server_Fire_Implementation(FVector CameraLocation, FRotator CameraRotation);
+	void Server_Fire(FVector CameraLocation, FRotator CameraRotation, double ClientTimestamp, uint16 FirstShotId);
+	bool Server_Fire_Validate(FVector CameraLocation, FRotator CameraRotation, double ClientTimestamp, uint16 FirstShotId);
+	void Server_Fire_Implementation(FVector CameraLocation, FRotator CameraRotation, double ClientTimestamp, uint16 FirstShotId);
 
-	/** Calling RPC of firing function */
+	/** Calling RPC of the stop firing function
+	 *	@param LastShotId The ID of the last shot predicted by the client, so that the server can confirm its ammunition count
+	 */
 	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_StopFire();
-	bool Server_StopFire_Validate();
-	void Server_StopFire_Implementation();
+	void Server_StopFire(uint16 LastShotId);
+	bool Server_StopFire_Validate(uint16 LastShotId);
+	void Server_StopFire_Implementation(uint16 LastShotId);
 
 	/** Calling RPC of reloading function */
 	UFUNCTION(Server, Reliable, WithValidation)
@@ -195,29 +268,24 @@ protected:
 	bool Server_Reload_Validate();
 	void Server_Reload_Implementation();
 
-	UFUNCTION(NetMultiCast, Reliable)
-	void Multi_UpdateMovementState(EMovementState NewMovementState);
-	void Multi_UpdateMovementState_Implementation(EMovementState NewMovementState);
-
-	UFUNCTION(Server, Reliable)
-	void Server_UpdateMovementState(EMovementState NewMovementState);
-	void Server_UpdateMovementState_Implementation(EMovementState NewMovementState);
-
-	UFUNCTION(Server, Reliable)
-	void Server_Vault(const FTransform TargetTransform);
-	void Server_Vault_Implementation(const FTransform TargetTransform);
-
-	UFUNCTION(NetMultiCast, Reliable)
-	void Multi_Vault(const FTransform TargetTransform);
-	void Multi_Vault_Implementation(const FTransform TargetTransform);
+	/** Applies the movement state received by simulated proxies */
+	UFUNCTION()
+	void OnRep_MovementState(EMovementState PreviousMovementState);
 
+	/** Sends the target of a vault to the server. The vault itself starts with the move that requests the vault state
+	 *	@param TargetLocation The location to which to move the player. Vault targets are only ever a location, so the
+	 *	rotation of the target transform is not sent
+	 */
 	UFUNCTION(Server, Reliable)
-	void Server_VaultTimelineTick(const float DeltaTime);
-	void Server_VaultTimelineTick_Implementation(const float DeltaTime);
+	void Server_Vault(FVector_NetQuantize10 TargetLocation);
+	void Server_Vault_Implementation(FVector_NetQuantize10 TargetLocation);
 
-	UFUNCTION(NetMultiCast, Reliable)
-	void Multi_VaultTimelineTick(const float DeltaTime);
-	void Multi_VaultTimelineTick_Implementation(const float DeltaTime);
+	/** Lets the owning client know that the server has refused the target of its vault, so that it stops predicting it
+	 *	@param TargetLocation The target that was refused
+	 */
+	UFUNCTION(Client, Reliable)
+	void Client_RejectVault(FVector_NetQuantize10 TargetLocation);
+	void Client_RejectVault_Implementation(FVector_NetQuantize10 TargetLocation);
 
 	UFUNCTION(NetMultiCast, Reliable)
 	void Multi_SlideAnim();
@@ -277,13 +345,28 @@ private:
 #pragma region FUNCTIONS
 
 	/** Sets default values for this character's properties */
-	AFPSCharacter();
+	explicit AFPSCharacter(const FObjectInitializer &ObjectInitializer);
+
+	/** Called once all of the character's components have been initialised */
+	virtual void PostInitializeComponents() override;
 
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
 
+	/** Called when the character is destroyed or removed from the level */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void PawnClientRestart() override;
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty> &OutLifetimeProps) const override;
+
+	/** Keeps the camera in place while the capsule is resized, and lets it interpolate to its crouched height instead */
+	virtual void OnStartCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) override;
+	virtual void OnEndCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) override;
+
+	/** Crouched and sliding characters may still jump */
+	virtual bool CanJumpInternal_Implementation() const override;
+
 	/** Alternative to the built in Crouch function
 	 *  Handles crouch input and decides what action to perform based on the character's current state
 	 */
@@ -313,26 +396,57 @@ private:
 	/** Slide Timing Out */
 	void TimeOutSlide();
 
-	/** Function that runs on tick and checks if we should execute the Vault() functions */
+	/** Function that runs on tick and checks if we should execute the Vault() functions. Looks up the ledges baked for the
+	 *	map (see UVaultLedgeSubsystem), and only traces for a ledge where none have been baked, starting with an async sweep
+	 *	for a wall whose result is used during the next frame */
 	void CheckVault();
 
+	/** Continues the vault check once the async sweep for a wall in front of the character has been performed */
+	void OnVaultWallTraced(const FTraceHandle &TraceHandle, FTraceDatum &TraceData);
+
+	/** Vaults over (or mantles onto) a ledge that was found in front of the character */
+	void VaultToLedge(const FVaultLedge &Ledge);
+
+	/** Returns the parameters of every vault trace */
+	FCollisionQueryParams GetVaultQueryParams() const;
+
+	/** Returns the location that a vault onto (or over) the given ledge moves the character to */
+	FVector GetVaultTargetLocation(const FVaultLedge &Ledge) const;
+
+	/** Checks a vault target sent by the owning client against the ledge that the server finds in front of the character
+	 *	@param TargetLocation The target sent by the client
+	 *	@param OutTargetLocation The target to vault to. The client's if it is close to the server's, the server's otherwise
+	 *	@return Whether the character can vault, false when the target is out of reach or no ledge is in front of it
+	 */
+	bool ValidateVaultTarget(const FVector &TargetLocation, FVector &OutTargetLocation) const;
+
 	/** Function that actually executes the Vault
 	 * @param TargetTransform The location to which to interpolate the player
 	 */
 	void Vault(FTransform TargetTransform);
 
-	/** Checks the angle of the floor to determine slide behaviour */
+	/** Updates the flags, weapon restrictions and animations that depend on the movement state after it has changed */
+	void OnMovementStateChanged(EMovementState PreviousMovementState);
+
+	/** Checks the angle of the floor to determine slide behaviour, using the movement component's floor while on the ground */
 	void CheckGroundAngle(float DeltaTime);
 
 	/** Checks the relative angle that the player is moving in (forwards/backwards/left/right) to determine if they can sprint */
 	float CheckRelativeMovementAngle(float DeltaTime) const;
 
-	/** Trace above the player to make sure we have enough space to stand up */
+	/** Trace above the player to make sure we have enough space to stand up. Answered by the async check requested during
+	 *	the previous frame when the player has barely moved since, and only once per frame */
 	bool HasSpaceToStandUp();
 
-	/** Ticks the timeline */
-	UFUNCTION()
-	void TimelineProgress(float Value);
+	/** Requests a check of whether the player has enough space to stand up from the async trace system */
+	void RequestStandUpCheck();
+
+	/** Stores the result of the async stand up check */
+	void OnStandUpTraced(const FTraceHandle &TraceHandle, FTraceDatum &TraceData);
+
+	/** Returns the location and shape of the space that has to be free for the player to stand up */
+	FVector GetStandUpCheckLocation() const;
+	FCollisionShape GetStandUpCheckShape() const;
 
 	/** Move the character left/right and forward/back
 	 *	@param Value The value passed in by the Input Component
@@ -350,9 +464,42 @@ private:
 	/** Ends ADS */
 	void StopAds();
 
-	/** Called every frame */
+	/** Called every frame, runs the tick tasks that are due */
 	virtual void Tick(float DeltaTime) override;
 
+	/** Registers the parts of the character's per-frame work as tick tasks */
+	void RegisterTickTasks();
+
+	/** Adds a tick task
+	 *	@param StatId The cycle stat to record the task's time in
+	 *	@param NetFilter The machines that the task runs on
+	 *	@param Interval The time between two runs of the task, in seconds (0 to run every frame)
+	 *	@param Run Updates the task, given the time since it last ran
+	 *	@param IsDirty Returns whether the task has anything to update, if it can be skipped
+	 */
+	void RegisterTickTask(TStatId StatId, ECharacterTickNetFilter NetFilter, float Interval, TFunction<void(float)> &&Run, TFunction<bool()> &&IsDirty = nullptr);
+
+	/** Returns whether tasks with the given net filter run on this machine */
+	bool PassesNetFilter(ECharacterTickNetFilter NetFilter) const;
+
+	/** Interpolates the camera to its standing or crouched height */
+	void UpdateCameraOffset(float DeltaTime);
+
+	/** Returns the height that the camera is interpolating to */
+	float GetTargetCameraOffset() const;
+
+	/** Drops out of sprinting when moving at too wide an angle, and back into it once the angle is narrow enough again */
+	void UpdateSprintAngle(float DeltaTime);
+
+	/** Interpolates the camera's field of view to the one of the current movement and aiming state */
+	void UpdateFieldOfView(float DeltaTime);
+
+	/** Slides once the player lands, if they pressed the slide key in the air */
+	void CheckSlideOnLanding();
+
+	/** Prints the ammunition and health of every equipped weapon */
+	void DrawWeaponDebug(float DeltaTime) const;
+
 #pragma endregion
 
 #pragma region USER_VARIABLES
@@ -361,6 +508,22 @@ private:
 	UPROPERTY(EditDefaultsOnly, Category = "Debug")
 	bool bDrawDebug;
 
+	/** The time in seconds between two checks for obstacles to vault over (0 to check every frame) */
+	UPROPERTY(EditDefaultsOnly, Category = "Performance")
+	float VaultCheckInterval = 1.0f / 30.0f;
+
+	/** The time in seconds between two checks of the angle between the movement and the view while sprinting */
+	UPROPERTY(EditDefaultsOnly, Category = "Performance")
+	float SprintAngleCheckInterval = 0.05f;
+
+	/** The time in seconds between two checks of the angle of the floor */
+	UPROPERTY(EditDefaultsOnly, Category = "Performance")
+	float GroundAngleCheckInterval = 0.05f;
+
+	/** How far the player can move after an async stand up check before its result is no longer used */
+	UPROPERTY(EditDefaultsOnly, Category = "Performance")
+	float StandUpCheckTolerance = 10.0f;
+
 	/** Sets the height of the player's capsule component when crouched */
 	UPROPERTY(EditDefaultsOnly, Category = "Movement | Crouch")
 	float CrouchedCapsuleHalfHeight = 58.0f;
@@ -413,7 +576,12 @@ private:
 	UPROPERTY(EditDefaultsOnly, Category = "Movement | Vault")
 	float VaultSpaceHeight = 50.0f;
 
-	/** Curve that controls motion during vault */
+	/** How far the vault target sent by a client may be from the one found by the server, as the client is ahead of the
+	 *	server and baked ledges are spaced apart */
+	static constexpr float VaultTargetTolerance = 100.0f;
+
+	/** Curve that controls motion during vault, mapping time to the fraction of the distance to the target that has been
+	 *	covered (from 0 to 1). The duration of the vault is the time range of the curve */
 	UPROPERTY(EditAnywhere, Category = "Movement | Vault")
 	UCurveFloat *VaultTimelineCurve;
 
@@ -437,25 +605,16 @@ private:
 
 #pragma region INTERNAL_VARIABLES
 
-	/** Enumerator holding the 5 possible movement states defined by EMovementState */
-	UPROPERTY()
+	/** Enumerator holding the 5 possible movement states defined by EMovementState. Set by the movement component's
+	 *	moves, and replicated to simulated proxies */
+	UPROPERTY(ReplicatedUsing = OnRep_MovementState)
 	EMovementState MovementState;
 
-	/** The timeline for vaulting (generated from the curve) */
-	UPROPERTY()
-	FTimeline VaultTimeline;
-
 	/** Hit results for various line traces */
 	FHitResult FootstepHit;
 
 	FHitResult StandUpHit;
 
-	FHitResult VaultHit;
-
-	FHitResult VaultHeightHit;
-
-	FHitResult MantleHit;
-
 	FHitResult AngleHit;
 
 	/** Whether the player is holding down the aim down sights button */
@@ -498,12 +657,6 @@ private:
 	/** Whether the character is crouching */
 	bool bIsCrouching = false;
 
-	/** The start location of a vaulting or mantle */
-	FTransform VaultStartLocation;
-
-	/** The end location of a vault or mantle */
-	FTransform VaultEndLocation;
-
 	/** Set automatically, the base height of the capsule */
 	float DefaultCapsuleHalfHeight;
 
@@ -553,6 +706,41 @@ private:
 	UPROPERTY()
 	UInventoryComponent *InventoryComponent;
 
+	/** The parts of the character's per-frame work, run by Tick */
+	TArray<FCharacterTickTask> TickTasks;
+
+	/** Hands the result of the async wall sweep of a vault check back to OnVaultWallTraced */
+	FTraceDelegate VaultWallTraceDelegate;
+
+	/** Where the player was, and the direction they were facing, when the latest vault wall sweep was requested */
+	FVector VaultTraceLocation = FVector::ZeroVector;
+	FVector VaultTraceForward = FVector::ForwardVector;
+
+	/** Whether a vault wall sweep has been requested, and its result has not come back yet */
+	bool bVaultWallTraceInFlight = false;
+
+	/** Hands the result of the async stand up check back to OnStandUpTraced */
+	FTraceDelegate StandUpTraceDelegate;
+
+	/** Where the latest async stand up check was requested */
+	FVector PendingStandUpTraceLocation = FVector::ZeroVector;
+
+	/** Where the latest async stand up check whose result has come back was performed */
+	FVector StandUpTraceLocation = FVector::ZeroVector;
+
+	/** The frame during which the result of the latest async stand up check came back */
+	uint64 StandUpTraceFrame = 0;
+
+	/** Whether the latest async stand up check found enough space to stand up */
+	bool bStandUpTraceResult = false;
+
+	/** Whether an async stand up check has been requested, and its result has not come back yet */
+	bool bStandUpTraceInFlight = false;
+
+	/** The frame of, and the result of, the latest call to HasSpaceToStandUp */
+	uint64 StandUpResultFrame = 0;
+	bool bHasSpaceToStandUp = false;
+
 	FTimerHandle WaitForAnim;
 
 	FTimerHandle ActiveTimer;
@@ -5,6 +5,29 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+/** Stat group used by all of FPS Core's runtime systems (stat FPSCore) */
+DECLARE_STATS_GROUP(TEXT("FPSCore"), STATGROUP_FPSCore, STATCAT_Advanced);
+
+class AActor;
+class UAnimMontage;
+class USkeletalMeshComponent;
+
+namespace FPSCore
+{
+	/** Whether cosmetics (effects, sounds and first person or weapon animations) are played for the given actor. Dedicated
+	 *	servers have nobody to show them to, and server builds compile them away entirely */
+#if UE_SERVER
+	FORCEINLINE bool ShouldPlayCosmetics(const AActor *Actor) { return false; }
+#else
+	FPSCORE_API bool ShouldPlayCosmetics(const AActor *Actor);
+#endif
+
+	/** Plays a montage on a mesh, if the mesh has an anim instance to play it with. Meshes have none when animation is
+	 *	disabled, which dedicated servers may do
+	 *	@return The length of the montage, or 0 if it was not played */
+	FPSCORE_API float PlayMontage(const USkeletalMeshComponent *Mesh, UAnimMontage *Montage);
+}
+
 class FPSCORE_API FFPSCoreModule : public IModuleInterface
 {
 public:
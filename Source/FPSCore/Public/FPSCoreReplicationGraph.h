@@ -0,0 +1,93 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "FPSCoreReplicationGraph.generated.h"
+
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_GridSpatialization2D;
+
+/** How the actors of a class are routed to the nodes of the replication graph */
+enum class EFPSCoreClassRepNodeMapping : uint8
+{
+	/** Not added to any node. Replicated by a per-connection node (player controllers) or not at all */
+	NotRouted,
+
+	/** Replicated to every connection */
+	RelevantAllConnections,
+
+	/** Added to the spatial grid once, and never moved in it */
+	Spatialize_Static,
+
+	/** Moved around the spatial grid every frame */
+	Spatialize_Dynamic,
+
+	/** Treated as static while dormant, and as dynamic while awake */
+	Spatialize_Dormancy,
+
+	/** Replicated alongside its owner, to the connections that its owner is replicated to */
+	DependentOfOwner
+};
+
+/** Replication graph for FPS Core projects.
+ *
+ *	The default replication driver considers every replicated actor for every connection every net tick. This graph
+ *	splits the world into a spatial grid instead, so that each connection only considers the actors in the cells around
+ *	its viewer:
+ *	- Characters are dynamic actors of the grid.
+ *	- Weapons are dependents of their owning character, and are only replicated along with it. They share its cull
+ *	  distance, rather than using their own NetCullDistanceSquared and IsNetRelevantFor as with the default driver.
+ *	- Pickups and interaction actors are static actors of the grid, which may go dormant.
+ *	- Player controllers (including AFPSCharacterController) are only replicated to their own connection.
+ *	- Any other always relevant actor (game state, player states) is replicated to every connection.
+ *
+ *	Enabled by setting it as the replication driver of the game net driver, in the project's DefaultEngine.ini:
+ *		[/Script/OnlineSubsystemUtils.IpNetDriver]
+ *		ReplicationDriverClassName=/Script/FPSCore.FPSCoreReplicationGraph
+ *	Compare stat FPSCore's FPSCore Replication Graph against stat net's server replicate actors time, with and without
+ *	the graph, to measure the difference.
+ */
+UCLASS(Transient, Config = Engine)
+class FPSCORE_API UFPSCoreReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	/** UReplicationGraph implementation */
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection *ConnectionManager) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo &ActorInfo, FGlobalActorReplicationInfo &GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo &ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	/** The size of a cell of the spatial grid */
+	UPROPERTY(Config)
+	float GridCellSize = 10000.0f;
+
+	/** The lowest X and Y coordinates covered by the grid. Anything below this is clamped into the first cells */
+	UPROPERTY(Config)
+	float SpatialBiasX = -150000.0f;
+	UPROPERTY(Config)
+	float SpatialBiasY = -200000.0f;
+
+private:
+	/** Returns how the actors of a class are routed */
+	EFPSCoreClassRepNodeMapping GetMappingPolicy(const UClass *Class);
+
+	/** Decides how the actors of a class are routed when no explicit policy has been set for it */
+	EFPSCoreClassRepNodeMapping GetDefaultMappingPolicy(const AActor *ActorCDO) const;
+
+	/** How the actors of every class are routed */
+	TClassMap<EFPSCoreClassRepNodeMapping> ClassRepNodePolicies;
+
+	/** The spatial grid holding characters, pickups and interaction actors */
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D *GridNode;
+
+	/** Actors replicated to every connection */
+	UPROPERTY()
+	UReplicationGraphNode_ActorList *AlwaysRelevantNode;
+};
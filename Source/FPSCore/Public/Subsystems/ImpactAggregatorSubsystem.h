@@ -0,0 +1,78 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ImpactAggregatorSubsystem.generated.h"
+
+class UNiagaraComponent;
+class UNiagaraSystem;
+
+/** The impacts of a single batched impact system collected during a frame */
+USTRUCT()
+struct FImpactBatch
+{
+	GENERATED_BODY()
+
+	/** The persistent component playing the batched system */
+	UPROPERTY()
+	UNiagaraComponent *Component = nullptr;
+
+	/** The world location of every impact this frame */
+	TArray<FVector> Locations;
+
+	/** The surface normal of every impact this frame */
+	TArray<FVector> Normals;
+
+	/** Whether the component was fed any impacts last frame, and needs to be cleared */
+	bool bHasPendingImpacts = false;
+};
+
+/** Renders the impacts of every weapon through one persistent Niagara system per surface, rather than one system
+ *	instance per impact.
+ *
+ *	Weapons add the frame's impacts as they happen, grouped by the batched impact system of the hit surface (see
+ *	FSurfaceResponse::BatchedImpactEffect). At the end of the frame every group is handed to its system in one go through
+ *	Niagara array data interfaces, so the cost of impacts grows with the amount of surfaces hit rather than the amount of
+ *	bullets fired.
+ *
+ *	Batched systems are expected to simulate in world space with fixed bounds, and to spawn one burst of particles per
+ *	entry of the User.ImpactLocations and User.ImpactNormals arrays (User.ImpactCount holds their length).
+ *
+ *	Not created on dedicated servers, which do not play any effects.
+ */
+UCLASS()
+class FPSCORE_API UImpactAggregatorSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** The names of the user parameters that impacts are fed through */
+	static const FName ImpactLocationsParameter;
+	static const FName ImpactNormalsParameter;
+	static const FName ImpactCountParameter;
+
+	/** Creates the persistent component of a batched impact system ahead of the first impact */
+	void Prewarm(UNiagaraSystem *System);
+
+	/** Adds an impact to be rendered by a batched system at the end of the frame */
+	void AddImpact(UNiagaraSystem *System, const FVector &Location, const FVector &Normal);
+
+	/** UTickableWorldSubsystem implementation */
+	virtual bool ShouldCreateSubsystem(UObject *Outer) const override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** Returns the batch of a system, creating its persistent component if needed */
+	FImpactBatch &FindOrAddBatch(UNiagaraSystem *System);
+
+	/** Hands a batch's impacts to its component */
+	static void FlushBatch(FImpactBatch &Batch);
+
+	/** The impacts of every batched system */
+	UPROPERTY()
+	TMap<UNiagaraSystem *, FImpactBatch> Batches;
+};
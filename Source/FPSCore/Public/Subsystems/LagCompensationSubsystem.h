@@ -0,0 +1,103 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LagCompensationSubsystem.generated.h"
+
+class AFPSCharacter;
+
+/** Server-side lag compensation. Keeps a fixed-size history of every registered character's hitbox transform, and
+ *	is able to temporarily move all of them back to where they were at a given point in time, so that shots can be
+ *	traced against the world as the shooting client saw it.
+ *
+ *	The history is stored as a structure of arrays, with each character owning a contiguous block of HistoryLength
+ *	samples in each array, so that rewinding only ever touches a handful of tightly packed cache lines per character.
+ */
+UCLASS()
+class FPSCORE_API ULagCompensationSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** The amount of samples kept per character (the ring buffer size) */
+	static constexpr int32 HistoryLength = 64;
+
+	/** The furthest back in time, in seconds, that the server is willing to rewind characters */
+	static constexpr double MaxRewindTime = 0.25;
+
+	/** Starts recording the hitbox history of a character (server only) */
+	void RegisterCharacter(AFPSCharacter *Character);
+
+	/** Stops recording the hitbox history of a character and frees up its slot */
+	void UnregisterCharacter(AFPSCharacter *Character);
+
+	/** Moves every registered character back to where it was at the given server time
+	 *	@param Timestamp The server time (in seconds) to rewind to, clamped to MaxRewindTime
+	 *	@param IgnoredCharacter A character which should not be rewound (usually the shooter)
+	 *	@warning Every call must be followed by a call to RestoreCharacters()
+	 */
+	void RewindCharacters(double Timestamp, const AFPSCharacter *IgnoredCharacter);
+
+	/** Moves every character moved by RewindCharacters() back to its present position */
+	void RestoreCharacters();
+
+	/** Returns whether characters are currently rewound */
+	bool IsRewound() const { return RewoundSlots.Num() > 0; }
+
+	/** Clamps a client-provided timestamp to the range of time that we are able to rewind to */
+	double ClampRewindTimestamp(double Timestamp) const;
+
+	/** Returns the time of the recorded snapshot closest to the given timestamp, or the current time if the present pose
+	 *	is closer. Rewinds to the same snapshot can be shared, but skip the interpolation between snapshots that
+	 *	RewindCharacters would otherwise perform
+	 */
+	double SnapRewindTimestamp(double Timestamp) const;
+
+	/** UTickableWorldSubsystem implementation */
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** Records the current hitbox transform of every registered character */
+	void RecordSnapshot();
+
+	/** The characters being tracked, indexed by slot. Unused slots hold a null pointer */
+	TArray<TWeakObjectPtr<AFPSCharacter>> Characters;
+
+	/** Slots which have been freed up by UnregisterCharacter and can be reused */
+	TArray<int32> FreeSlots;
+
+	/** The index (within its slot's block) of the newest sample of every slot */
+	TArray<int32> HeadIndices;
+
+	/** The amount of valid samples in every slot */
+	TArray<int32> SampleCounts;
+
+	/** Sample timestamps, laid out as [Slot * HistoryLength + Sample] */
+	TArray<double> Timestamps;
+
+	/** Sample locations, laid out as [Slot * HistoryLength + Sample] */
+	TArray<FVector> Locations;
+
+	/** Sample rotations, laid out as [Slot * HistoryLength + Sample] */
+	TArray<FQuat> Rotations;
+
+	/** The time of every recorded snapshot, as a ring buffer of HistoryLength samples */
+	TArray<double> SnapshotTimes;
+
+	/** The index of the newest snapshot in SnapshotTimes */
+	int32 SnapshotHead = 0;
+
+	/** The amount of valid snapshots in SnapshotTimes */
+	int32 SnapshotCount = 0;
+
+	/** The slots that have been moved by the last call to RewindCharacters */
+	TArray<int32> RewoundSlots;
+
+	/** The present transforms of the rewound slots, parallel to RewoundSlots */
+	TArray<FVector> SavedLocations;
+
+	TArray<FQuat> SavedRotations;
+};
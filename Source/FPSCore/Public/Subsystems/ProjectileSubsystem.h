@@ -0,0 +1,92 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectileSubsystem.generated.h"
+
+class AWeaponBase;
+
+/** Simulates every projectile fired by projectile weapons (see FStaticWeaponData::bUseProjectiles), without spawning an
+ *	actor or component per bullet.
+ *
+ *	Live projectiles are stored as a structure of arrays, so that integration can advance four projectiles at a time with
+ *	SIMD. Every step is then swept as a line segment against the world (in parallel, as scene queries are read-only),
+ *	and the resulting hits are handed back to their weapon on the game thread, in a deterministic order.
+ *
+ *	The server simulates authoritative projectiles which deal damage, while clients simulate cosmetic ones.
+ */
+UCLASS()
+class FPSCORE_API UProjectileSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Starts simulating a new projectile
+	 *	@param Weapon The weapon which fired the projectile, notified when it hits something
+	 *	@param Origin Where the projectile starts
+	 *	@param Velocity The initial velocity of the projectile (in cm/s)
+	 *	@param GravityScale The multiplier applied to the world's gravity
+	 *	@param Drag The fraction of its velocity that the projectile loses every second
+	 *	@param Lifetime The time (in seconds) after which the projectile is removed if it has not hit anything
+	 *	@param bAuthoritative Whether hits should deal damage (server) or only play effects (clients)
+	 */
+	void SpawnProjectile(AWeaponBase *Weapon, const FVector &Origin, const FVector &Velocity, float GravityScale, float Drag, float Lifetime, bool bAuthoritative);
+
+	/** Returns the amount of projectiles currently being simulated */
+	int32 GetNumProjectiles() const { return PositionsX.Num(); }
+
+	/** UTickableWorldSubsystem implementation */
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** Advances the position and velocity of every projectile, keeping the position from before the step */
+	void Integrate(float DeltaTime);
+
+	/** Sweeps every projectile from its previous position to its current one */
+	void Sweep();
+
+	/** Hands hits back to their weapons and removes projectiles that have hit something or expired */
+	void Resolve();
+
+	/** Removes a projectile by swapping the last one into its place */
+	void RemoveProjectile(int32 Index);
+
+	/** Current positions */
+	TArray<float> PositionsX;
+	TArray<float> PositionsY;
+	TArray<float> PositionsZ;
+
+	/** Positions before the latest step, the start of every sweep */
+	TArray<float> PreviousX;
+	TArray<float> PreviousY;
+	TArray<float> PreviousZ;
+
+	/** Current velocities */
+	TArray<float> VelocitiesX;
+	TArray<float> VelocitiesY;
+	TArray<float> VelocitiesZ;
+
+	/** The vertical acceleration of every projectile (the world's gravity multiplied by its gravity scale) */
+	TArray<float> Gravities;
+
+	/** The fraction of velocity lost every second */
+	TArray<float> Drags;
+
+	/** The time every projectile has left before it is removed */
+	TArray<float> RemainingLifetimes;
+
+	/** The weapon which fired every projectile */
+	TArray<TWeakObjectPtr<AWeaponBase>> Weapons;
+
+	/** Whether every projectile deals damage */
+	TArray<bool> Authoritative;
+
+	/** The result of the latest sweep of every projectile */
+	TArray<FHitResult> SweepResults;
+
+	/** Whether the latest sweep of every projectile hit something */
+	TArray<bool> SweepHits;
+};
@@ -0,0 +1,78 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WeaponBase.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShotResolverSubsystem.generated.h"
+
+/** Resolves every line trace shot fired during a frame in one batch (server only).
+ *
+ *	Rather than tracing inside AWeaponBase::Fire one pellet at a time, weapons queue their shots here. At the end of the
+ *	frame shots are grouped by rewind time, and every group is traced in parallel with a single rewind. Shots at the
+ *	present pose are traced without rewinding at all. Damage, hit events and impact multicasts are then applied serially,
+ *	in the order in which the shots were queued, so that the outcome does not depend on how the traces were scheduled.
+ *
+ *	With FPSCore.SnapShotRewinds (the default), rewind times are snapped to the closest lag compensation snapshot so
+ *	that shots fired close together share a group. This gives up the interpolation between snapshots, which can put
+ *	hitboxes up to half a snapshot interval away from where the shooter saw them. Disabling it rewinds every shot to
+ *	its own interpolated time, at the cost of one rewind per distinct time.
+ */
+UCLASS()
+class FPSCORE_API UShotResolverSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Queues a shot to be traced at the end of the frame
+	 *	@param Weapon The weapon firing the shot, which must have already consumed the shot's ammunition and shot ID
+	 *	@param RewindTime The server time that other players should be rewound to when tracing the shot
+	 */
+	void QueueShot(AWeaponBase *Weapon, const FVector &CameraLocation, const FRotator &CameraRotation, double RewindTime);
+
+	/** UTickableWorldSubsystem implementation */
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** A shot waiting to be resolved */
+	struct FQueuedShot
+	{
+		/** The weapon that fired the shot */
+		TWeakObjectPtr<AWeaponBase> Weapon;
+
+		/** The parameters of the shot, to which the impacts are added once resolved */
+		FWeaponImpactBatch ImpactBatch;
+
+		/** The rewind time of the shot, snapped to a lag compensation snapshot by Tick when FPSCore.SnapShotRewinds is set */
+		double RewindTime = 0.0;
+
+		/** The index of the first pellet of this shot in the trace arrays */
+		int32 FirstTrace = 0;
+
+		/** The amount of pellets of this shot */
+		int32 NumTraces = 0;
+	};
+
+	/** Traces every pellet of the given shots, with other players rewound to the shots' (shared) rewind time */
+	void TraceShots(TConstArrayView<int32> ShotIndices);
+
+	/** Applies the results of every shot in the order in which they were queued */
+	void ApplyShots();
+
+	/** The shots queued this frame */
+	TArray<FQueuedShot> QueuedShots;
+
+	/** The start of every pellet trace */
+	TArray<FVector> TraceStarts;
+
+	/** The end of every pellet trace */
+	TArray<FVector> TraceEnds;
+
+	/** The result of every pellet trace */
+	TArray<FHitResult> TraceResults;
+
+	/** Whether every pellet trace hit something */
+	TArray<bool> TraceHits;
+};
@@ -0,0 +1,56 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "VaultLedgeSubsystem.generated.h"
+
+class UVaultLedgeData;
+struct FVaultLedge;
+struct FVaultLedgeSettings;
+
+/** The result of looking for a baked ledge */
+enum class EVaultLedgeLookup : uint8
+{
+	/** No ledges have been baked for the character around its location, so it has to trace for one */
+	Unbaked,
+	/** Ledges have been baked around the character, and none are in front of it */
+	NoLedge,
+	/** A baked ledge is in front of the character */
+	Found
+};
+
+/** Loads the ledges baked for the current map by UVaultLedgeBakeCommandlet (from the package named after the map, see
+ *	UVaultLedgeData::GetPackageNameForMap), and answers characters looking for somewhere to vault or mantle to.
+ *
+ *	Baked ledges only cover static and stationary geometry, and characters within the baked bounds do not trace, so maps
+ *	with movable geometry which can be vaulted onto should not be baked (the bake warns about such geometry). Ledge
+ *	packages are loaded by name, so their directory has to be cooked (see "Additional Asset Directories to Cook" in the
+ *	packaging settings).
+ */
+UCLASS()
+class FPSCORE_API UVaultLedgeSubsystem final : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Looks for a baked ledge in front of a character
+	 *	@param Location The location of the middle of the character
+	 *	@param Forward The direction that the character is facing
+	 *	@param Settings The properties of the character, which have to match the ones that the ledges were baked for
+	 *	@param OutLedge The ledge that was found
+	 */
+	EVaultLedgeLookup FindLedge(const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, FVaultLedge &OutLedge) const;
+
+	/** Returns the ledges of the current map, or nullptr if none have been baked */
+	const UVaultLedgeData *GetLedgeData() const { return LedgeData; }
+
+	/** UWorldSubsystem implementation */
+	virtual void OnWorldBeginPlay(UWorld &InWorld) override;
+
+private:
+	/** The ledges of the current map */
+	UPROPERTY(Transient)
+	UVaultLedgeData *LedgeData;
+};
@@ -0,0 +1,90 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponAudioSubsystem.generated.h"
+
+class AWeaponBase;
+class UAudioComponent;
+class USoundBase;
+class USoundConcurrency;
+
+/** The looping fire sound of a single weapon */
+USTRUCT()
+struct FWeaponFireLoop
+{
+	GENERATED_BODY()
+
+	/** The component playing the loop, kept between bursts so that it is not recreated for every burst */
+	UPROPERTY()
+	UAudioComponent *AudioComponent = nullptr;
+
+	/** The sound played when the loop stops */
+	UPROPERTY()
+	USoundBase *TailSound = nullptr;
+
+	/** The concurrency settings of the weapon */
+	UPROPERTY()
+	USoundConcurrency *Concurrency = nullptr;
+
+	/** The world time of the latest shot */
+	double LastShotTime = 0.0;
+
+	/** The time between two shots of the weapon */
+	double ShotInterval = 0.0;
+};
+
+/** Plays weapon fire sounds while keeping the amount of voices bounded during large fights.
+ *
+ *	- Every weapon class shares a concurrency limit between its instances (or uses the weapon's own SoundConcurrency),
+ *	  stopping the farthest voices first.
+ *	- Sounds which no listener is within range of are culled before an active sound is ever created.
+ *	- High rate of fire automatic weapons with a FireLoopSound play a single looping voice for as long as they keep
+ *	  firing instead of one voice per shot, started with their FireStartSound and followed by their FireTailSound.
+ *	  Remote clients are not told when a weapon stops firing, so loops also stop on their own once shots stop arriving.
+ *
+ *	Not created on dedicated servers, which do not play any sounds.
+ */
+UCLASS()
+class FPSCORE_API UWeaponAudioSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Plays the fire sound of a weapon's shot, or keeps its fire loop going
+	 *	@param SoundComponent The component that the sound plays from
+	 *	@param SocketName The socket of SoundComponent that the sound plays from
+	 */
+	void PlayFireSound(AWeaponBase *Weapon, USceneComponent *SoundComponent, FName SocketName);
+
+	/** Stops the fire loop of a weapon, if it is playing one, and plays its tail */
+	void StopFireLoop(AWeaponBase *Weapon);
+
+	/** Plays a one-shot weapon sound, unless no listener is within range of it */
+	void PlayWeaponSound(AWeaponBase *Weapon, USoundBase *Sound, const FVector &Location);
+
+	/** UTickableWorldSubsystem implementation */
+	virtual bool ShouldCreateSubsystem(UObject *Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** Returns the concurrency settings that a weapon's sounds play with */
+	USoundConcurrency *GetConcurrency(AWeaponBase *Weapon);
+
+	/** Returns whether any listener is within range of a sound played at Location */
+	bool IsAudible(const USoundBase *Sound, const FVector &Location) const;
+
+	/** Stops a fire loop and plays its tail */
+	void StopLoop(FWeaponFireLoop &Loop);
+
+	/** The default concurrency settings of every weapon class without its own */
+	UPROPERTY()
+	TMap<UClass *, USoundConcurrency *> ClassConcurrency;
+
+	/** The fire loop of every weapon which has played one */
+	UPROPERTY()
+	TMap<TWeakObjectPtr<AWeaponBase>, FWeaponFireLoop> FireLoops;
+};
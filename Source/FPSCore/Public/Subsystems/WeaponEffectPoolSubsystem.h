@@ -0,0 +1,114 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponEffectPoolSubsystem.generated.h"
+
+class UNiagaraComponent;
+class UNiagaraSystem;
+class USceneComponent;
+
+/** Statistics of the weapon effect pool, used to size the amount of components that weapons prewarm */
+USTRUCT(BlueprintType)
+struct FWeaponEffectPoolStats
+{
+	GENERATED_BODY()
+
+	/** The amount of effects which were played by a component that was already in the pool */
+	UPROPERTY(BlueprintReadOnly, Category = "Effect Pool")
+	int32 Hits = 0;
+
+	/** The amount of effects which needed a new component to be created */
+	UPROPERTY(BlueprintReadOnly, Category = "Effect Pool")
+	int32 Misses = 0;
+
+	/** The amount of components currently playing an effect */
+	UPROPERTY(BlueprintReadOnly, Category = "Effect Pool")
+	int32 Active = 0;
+
+	/** The highest amount of components which have been playing an effect at the same time */
+	UPROPERTY(BlueprintReadOnly, Category = "Effect Pool")
+	int32 Peak = 0;
+
+	/** The amount of components owned by the pool, whether they are playing an effect or not */
+	UPROPERTY(BlueprintReadOnly, Category = "Effect Pool")
+	int32 Pooled = 0;
+};
+
+/** The idle components of a single Niagara system */
+USTRUCT()
+struct FWeaponEffectPool
+{
+	GENERATED_BODY()
+
+	/** Components which are registered, deactivated and ready to play this system */
+	UPROPERTY()
+	TArray<UNiagaraComponent *> FreeComponents;
+
+	/** The amount of components created for this system, whether they are free or not */
+	int32 NumComponents = 0;
+};
+
+/** Plays weapon effects (muzzle flashes, tracers, casings and impacts) through pooled Niagara components, rather than
+ *	creating and registering a new component for every effect of every shot.
+ *
+ *	Weapons prewarm the pool for their systems when they are spawned. Prewarming creates and registers the components
+ *	and activates each of them once, so that the cost of initialising a system is paid while loading rather than on the
+ *	first shot. Components are handed back to the pool automatically once their system has finished playing.
+ *
+ *	Not created on dedicated servers, which do not play any effects.
+ */
+UCLASS()
+class FPSCORE_API UWeaponEffectPoolSubsystem final : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Makes sure that the pool holds at least Count components for a system. Pools are shared between every weapon using
+	 *	the same system, so prewarming several weapons of the same type does not grow the pool any further */
+	void Prewarm(UNiagaraSystem *System, int32 Count);
+
+	/** Plays a system at a location in the world
+	 *	@return The component playing the effect, which must not be kept around as it returns to the pool once finished
+	 */
+	UNiagaraComponent *SpawnEffectAtLocation(UNiagaraSystem *System, const FVector &Location, const FRotator &Rotation);
+
+	/** Plays a system attached to a component, behaving like UNiagaraFunctionLibrary::SpawnSystemAttached(). Falls back to
+	 *	playing the system at Location if there is nothing to attach to
+	 *	@return The component playing the effect, which must not be kept around as it returns to the pool once finished
+	 */
+	UNiagaraComponent *SpawnEffectAttached(UNiagaraSystem *System, USceneComponent *AttachToComponent, FName AttachPointName, const FVector &Location, const FRotator &Rotation, EAttachLocation::Type LocationType);
+
+	/** Returns the statistics of the pool since the world started */
+	UFUNCTION(BlueprintCallable, Category = "Effect Pool")
+	FWeaponEffectPoolStats GetPoolStats() const { return Stats; }
+
+	/** UWorldSubsystem implementation */
+	virtual bool ShouldCreateSubsystem(UObject *Outer) const override;
+	virtual void Deinitialize() override;
+
+private:
+	/** Takes a free component for a system out of the pool, creating one if there are none left */
+	UNiagaraComponent *AcquireComponent(UNiagaraSystem *System);
+
+	/** Creates and registers a new (deactivated) component for a system */
+	UNiagaraComponent *CreateComponent(UNiagaraSystem *System);
+
+	/** Hands a component back to the pool once its system has finished playing */
+	UFUNCTION()
+	void OnEffectFinished(UNiagaraComponent *Component);
+
+	/** The idle components of every system */
+	UPROPERTY()
+	TMap<UNiagaraSystem *, FWeaponEffectPool> Pools;
+
+	/** The components currently playing an effect */
+	UPROPERTY()
+	TSet<UNiagaraComponent *> ActiveComponents;
+
+	/** Statistics of the pool */
+	FWeaponEffectPoolStats Stats;
+};
@@ -0,0 +1,74 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericTeamAgentInterface.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponSignificanceSubsystem.generated.h"
+
+class AWeaponBase;
+
+/** The cosmetic effects of a shot which are subject to the effect budget */
+enum class EWeaponCosmetic : uint8
+{
+	MuzzleFlash,
+	Tracer,
+	Casing
+};
+
+/** Scores every weapon's significance to the local players through the significance manager, and spends a per-frame
+ *	budget of cosmetic effects (muzzle flashes, tracers and casings) on the most significant ones.
+ *
+ *	A weapon's significance is the product of its distance to the closest viewpoint, whether it has recently been rendered
+ *	and the attitude of its owner's team towards the local player. Weapons held by local players are always fully
+ *	significant and never lose their effects.
+ *
+ *	The less significant a weapon is, the less of the frame's budget it may use: low significance weapons only play
+ *	their effects while most of the budget is still available, and simplify multi-pellet shots to a single tracer.
+ *	The budget is set by FPSCore.WeaponEffectBudget and shown in stat FPSCore.
+ *
+ *	Updates the significance manager with the local players' viewpoints every frame. Not created on dedicated servers.
+ */
+UCLASS()
+class FPSCORE_API UWeaponSignificanceSubsystem final : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** The tag that weapons are registered with in the significance manager */
+	static const FName SignificanceTag;
+
+	/** Starts scoring the significance of a weapon */
+	void RegisterWeapon(AWeaponBase *Weapon);
+
+	/** Stops scoring the significance of a weapon */
+	void UnregisterWeapon(AWeaponBase *Weapon);
+
+	/** Returns the significance of a weapon, between 0 (insignificant) and 1 (fully significant) */
+	float GetWeaponSignificance(const AWeaponBase *Weapon) const;
+
+	/** Returns whether a weapon may play an effect this frame, spending some of the frame's budget if so */
+	bool ConsumeEffectBudget(const AWeaponBase *Weapon, EWeaponCosmetic Cosmetic);
+
+	/** Returns whether a weapon's multi-pellet shots should only play a single tracer */
+	bool ShouldSimplifyEffects(const AWeaponBase *Weapon) const;
+
+	/** UTickableWorldSubsystem implementation */
+	virtual bool ShouldCreateSubsystem(UObject *Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	/** Scores a weapon from a single viewpoint, called by the significance manager */
+	float CalculateSignificance(const AWeaponBase *Weapon, const FTransform &Viewpoint) const;
+
+	/** The viewpoints of the local players, reused every frame */
+	TArray<FTransform> Viewpoints;
+
+	/** The team of the first local player, against which the attitude of every weapon's owner is checked */
+	FGenericTeamId LocalTeam = FGenericTeamId::NoTeam;
+
+	/** The amount of effects played this frame */
+	int32 EffectsPlayed = 0;
+};
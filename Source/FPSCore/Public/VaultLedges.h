@@ -0,0 +1,212 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "WorldCollision.h"
+#include "VaultLedges.generated.h"
+
+/** The properties of a character that decide where it can vault or mantle to */
+USTRUCT()
+struct FPSCORE_API FVaultLedgeSettings
+{
+	GENERATED_BODY()
+
+	/** How far in front of the character walls are looked for */
+	static constexpr float WallCheckDistance = 75.0f;
+
+	/** The radius of the capsule swept to look for walls */
+	static constexpr float WallCheckRadius = 30.0f;
+
+	/** The half height of the capsule swept to look for walls */
+	static constexpr float WallCheckHalfHeight = 50.0f;
+
+	/** How far above the middle of the character the top of a wall can be for the character to reach it */
+	static constexpr float LedgeCheckHeight = 100.0f;
+
+	/** The radius of the character's capsule */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float CapsuleRadius = 0.0f;
+
+	/** The half height of the character's capsule */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float CapsuleHalfHeight = 0.0f;
+
+	/** The height of the highest surface that the character can mantle up onto */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float MaxMantleHeight = 0.0f;
+
+	/** The amount of 5 unit steps over the top of a wall which are checked for a place to vault to */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	int32 VaultTraceAmount = 0;
+
+	/** The space that needs to be free above an obstacle for the character to vault over it */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float VaultSpaceHeight = 0.0f;
+
+	/** The minimum Z component of the normal of a surface that the character can stand on */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float WalkableFloorZ = 0.0f;
+
+	/** Whether ledges found with these settings are the ones that would be found with Other */
+	bool Matches(const FVaultLedgeSettings &Other) const;
+};
+
+/** A place that a character can vault over or mantle onto, found as it approaches a wall */
+USTRUCT()
+struct FPSCORE_API FVaultLedge
+{
+	GENERATED_BODY()
+
+	/** The point at the top of the wall which the character reaches for */
+	UPROPERTY()
+	FVector EdgeLocation = FVector::ZeroVector;
+
+	/** The normal of the wall, pointing away from it */
+	UPROPERTY()
+	FVector WallNormal = FVector::ZeroVector;
+
+	/** The point on the floor that the character lands on. The target of the vault is this point, raised by the character's
+	 *	half height */
+	UPROPERTY()
+	FVector LandingLocation = FVector::ZeroVector;
+
+	/** Whether the character vaults over the wall, rather than mantling onto it */
+	UPROPERTY()
+	bool bIsVault = false;
+};
+
+/** A cell of the spatial hash of a UVaultLedgeData, holding the ledges whose edge lies within it */
+USTRUCT()
+struct FPSCORE_API FVaultLedgeCell
+{
+	GENERATED_BODY()
+
+	/** The coordinates of the cell */
+	UPROPERTY()
+	FIntVector Coordinates = FIntVector::ZeroValue;
+
+	/** The index of the first ledge of the cell in UVaultLedgeData::Ledges */
+	UPROPERTY()
+	int32 FirstLedge = 0;
+
+	/** The amount of ledges in the cell */
+	UPROPERTY()
+	int32 NumLedges = 0;
+};
+
+/** The vaultable and mantleable ledges of a level, baked offline by UVaultLedgeBakeCommandlet from its static geometry.
+ *
+ *	Ledges are stored in a spatial hash, so that finding the ledge in front of a character is a lookup of the few cells
+ *	around it rather than the sweeps and traces that CheckVault would otherwise perform. Ledges are only valid for
+ *	characters with the settings they were baked with, and only within BakedBounds, outside of which characters trace.
+ */
+UCLASS()
+class FPSCORE_API UVaultLedgeData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** The suffix added to the name of a map to get the name of the package holding its ledges */
+	static const TCHAR *PackageSuffix;
+
+	/** Returns the name of the package holding the ledges of the map with the given (long) package name */
+	static FString GetPackageNameForMap(const FString &MapPackageName);
+
+	/** Returns the ledge in front of a character, or nullptr if it has nowhere to vault or mantle to
+	 *	@param Location The location of the middle of the character
+	 *	@param Forward The direction that the character is facing
+	 */
+	const FVaultLedge *FindLedge(const FVector &Location, const FVector &Forward) const;
+
+	/** Whether ledges have been baked around the given location */
+	bool IsBaked(const FVector &Location) const { return BakedBounds.IsValid && BakedBounds.IsInsideOrOn(Location); }
+
+	/** Returns the settings of the character that the ledges were baked for */
+	const FVaultLedgeSettings &GetSettings() const { return Settings; }
+
+	/** Returns the amount of baked ledges */
+	int32 GetNumLedges() const { return Ledges.Num(); }
+
+#if WITH_EDITOR
+	/** Replaces the baked ledges
+	 *	@param NewSettings The settings of the character that the ledges were found for
+	 *	@param NewBounds The area which was searched for ledges
+	 *	@param NewSampleSpacing The distance between two ledges along the same edge
+	 *	@param NewCellSize The size of the cells of the spatial hash
+	 *	@param NewLedges The ledges, in any order
+	 */
+	void SetLedges(const FVaultLedgeSettings &NewSettings, const FBox &NewBounds, float NewSampleSpacing, float NewCellSize, TArray<FVaultLedge> NewLedges);
+#endif
+
+	/** UObject implementation */
+	virtual void PostLoad() override;
+
+private:
+	/** Returns the coordinates of the cell containing the given location */
+	FIntVector GetCellCoordinates(const FVector &Location) const;
+
+	/** Builds CellLookup from Cells */
+	void BuildCellLookup();
+
+	/** The settings of the character that the ledges were baked for */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	FVaultLedgeSettings Settings;
+
+	/** The area which was searched for ledges */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	FBox BakedBounds = FBox(ForceInit);
+
+	/** The distance between two ledges along the same edge */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float SampleSpacing = 25.0f;
+
+	/** The size of the cells of the spatial hash */
+	UPROPERTY(VisibleAnywhere, Category = "Vault")
+	float CellSize = 200.0f;
+
+	/** Every ledge, sorted by cell */
+	UPROPERTY()
+	TArray<FVaultLedge> Ledges;
+
+	/** Every cell which holds at least one ledge */
+	UPROPERTY()
+	TArray<FVaultLedgeCell> Cells;
+
+	/** The index in Cells of the cell with the given coordinates */
+	TMap<FIntVector, int32> CellLookup;
+};
+
+namespace FPSCore
+{
+	/** Looks for a ledge in front of a character by sweeping and tracing against the world. This is the search that
+	 *	ledges are baked with, and that characters fall back to where no ledges have been baked
+	 *	@param World The world to trace against
+	 *	@param Location The location of the middle of the character
+	 *	@param Forward The direction that the character is facing
+	 *	@param Settings The properties of the character
+	 *	@param QueryParams The parameters of every trace
+	 *	@param OutLedge The ledge that was found
+	 *	@param bDrawDebug Whether to draw the traces
+	 *	@return Whether a ledge was found
+	 */
+	FPSCORE_API bool TraceVaultLedge(const UWorld *World, const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, const FCollisionQueryParams &QueryParams, FVaultLedge &OutLedge, bool bDrawDebug = false);
+
+	/** Requests the sweep for a wall in front of a character, which starts the search for a ledge, from the async trace
+	 *	system. The sweep is batched with every other async trace of the frame, and its result handed to Delegate during
+	 *	the next frame, for TraceVaultLedgeFromWall
+	 *	@param World The world to trace against
+	 *	@param Location The location of the middle of the character
+	 *	@param Forward The direction that the character is facing
+	 *	@param QueryParams The parameters of the sweep
+	 *	@param Delegate The delegate that the result of the sweep is handed to
+	 *	@param bDrawDebug Whether to draw the sweep
+	 */
+	FPSCORE_API FTraceHandle AsyncTraceVaultWall(UWorld *World, const FVector &Location, const FVector &Forward, const FCollisionQueryParams &QueryParams, FTraceDelegate *Delegate, bool bDrawDebug = false);
+
+	/** Continues the search for a ledge in front of a character from the wall that it found, see TraceVaultLedge
+	 *	@param WallHit The result of the sweep for a wall in front of the character
+	 */
+	FPSCORE_API bool TraceVaultLedgeFromWall(const UWorld *World, const FHitResult &WallHit, const FVector &Location, const FVector &Forward, const FVaultLedgeSettings &Settings, const FCollisionQueryParams &QueryParams, FVaultLedge &OutLedge, bool bDrawDebug = false);
+}
@@ -4,10 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "Camera/CameraShakeBase.h"
-#include "Components/TimelineComponent.h"
 #include "Engine/DataTable.h"
+#include "Engine/NetSerialization.h"
+#include "Engine/StreamableManager.h"
+#include "Chaos/ChaosEngineInterface.h"
 #include "GameFramework/Actor.h"
 #include "NiagaraComponent.h"
+#include "WeaponRecoil.h"
 #include "WeaponBase.generated.h"
 
 class AWeaponBase;
@@ -18,10 +21,12 @@ class UAnimMontage;
 class UAnimationAsset;
 class UAnimSequence;
 class UNiagaraSystem;
+class USoundConcurrency;
 class UBlendSpace;
 class USoundCue;
 class UPhysicalMaterial;
 class UDataTable;
+class UPrimitiveComponent;
 class AWeaponPickup;
 
 /** Enumerator holding the 4 types of ammunition that weapons can use (used as part of the FSingleWeaponParams struct)
@@ -246,8 +251,8 @@ struct FAttachmentData : public FTableRowBase
 	float WeaponHealth = 100.0f;
 
 	/** The rate of fire (In rounds per minute/RPM) of this magazine attachment */
-	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
-	float FireRate;
+	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine", ClampMin = "1"))
+	float FireRate = 600.0f;
 
 	/** Whether this magazine supports automatic fire */
 	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
@@ -273,8 +278,8 @@ struct FAttachmentData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
 	float ShotgunRange;
 
-	/** The amount of pellets fired */
-	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
+	/** The amount of pellets fired (at most 255, as pellets are indexed by a byte when replicated) */
+	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine", ClampMax = 255))
 	int ShotgunPellets;
 
 	/** The increase in shot variation when the player is not aiming down the sights */
@@ -311,11 +316,11 @@ struct FAttachmentData : public FTableRowBase
 
 	/** The firing sound to use instead of the default for this particular magazine attachment */
 	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
-	USoundBase *FiringSoundOverride;
+	TSoftObjectPtr<USoundBase> FiringSoundOverride;
 
 	/** The silenced firing sound to use instead of the default for this particular magazine attachment */
 	UPROPERTY(EditDefaultsOnly, Category = "Magazine", meta = (EditCondition = "AttachmentType == EAttachmentType::Magazine"))
-	USoundBase *SilencedFiringSoundOverride;
+	TSoftObjectPtr<USoundBase> SilencedFiringSoundOverride;
 
 	/** The offset applied to the camera to align with the sights */
 	UPROPERTY(EditDefaultsOnly, Category = "Sights", meta = (EditCondition = "AttachmentType == EAttachmentType::Sights"))
@@ -338,6 +343,67 @@ struct FAttachmentData : public FTableRowBase
 	float UnmagnifiedLFoV = 200.0f;
 };
 
+/** How a weapon's shots respond to hitting a single type of surface. Rows of a weapon's SurfaceResponseTable, which
+ *	may define any of the project's physical surface types */
+USTRUCT(BlueprintType)
+struct FSurfaceResponse : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	/** The physical surface type that this response applies to */
+	UPROPERTY(EditDefaultsOnly, Category = "Surface")
+	TEnumAsByte<EPhysicalSurface> Surface = SurfaceType_Default;
+
+	/** particle effect (Niagara system) to be spawned when this surface is hit */
+	UPROPERTY(EditDefaultsOnly, Category = "Surface")
+	TSoftObjectPtr<UNiagaraSystem> ImpactEffect;
+
+	/** particle effect (Niagara system) rendering every hit on this surface in a frame at once, used instead of ImpactEffect
+	 *	when set. See UImpactAggregatorSubsystem for the parameters that it needs to expose */
+	UPROPERTY(EditDefaultsOnly, Category = "Surface")
+	TSoftObjectPtr<UNiagaraSystem> BatchedImpactEffect;
+
+	/** sound to be played when this surface is hit */
+	UPROPERTY(EditDefaultsOnly, Category = "Surface")
+	TSoftObjectPtr<USoundBase> ImpactSound;
+
+	/** multiplier applied to the weapon's damage when this surface is hit (e.g. for headshots) */
+	UPROPERTY(EditDefaultsOnly, Category = "Surface")
+	float DamageMultiplier = 1.0f;
+};
+
+/** How long each of a weapon's actions takes. Gameplay is timed from these rather than from the animations that are
+ *	playing, so that servers never need to evaluate animation to know when a reload or shot cycle has finished */
+USTRUCT(BlueprintType)
+struct FWeaponActionDurations
+{
+	GENERATED_BODY()
+
+	/** The time taken to reload with rounds left in the magazine (PlayerReload) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float Reload = 0.0f;
+
+	/** The time taken to reload an empty magazine (EmptyPlayerReload) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float EmptyReload = 0.0f;
+
+	/** The time that the weapon waits after a shot when bWaitForAnim is set (Gun_Shot) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float ShotCycle = 0.0f;
+
+	/** The time that a shotgun waits after every second shot when bWaitForAnim is set (ShotGun_Shot2) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float AlternateShotCycle = 0.0f;
+
+	/** The time taken to take the weapon out (WeaponEquip) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float Equip = 0.0f;
+
+	/** The time taken to put the weapon away (WeaponUnequip) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Timing")
+	float Unequip = 0.0f;
+};
+
 /** Struct holding all required information about the weapon class. This data is set once at tbe beginning of this
  * actor's lifetime, and then remains unchanged for it's duration. It encapsulates all the data regarding the statistics
  * of this weapon, as well as data regarding it's appearance, such as animations and particle effects.
@@ -379,6 +445,28 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Required")
 	float WeaponYawVariation;
 
+	/** Projectiles */
+
+	/** Whether this weapon fires simulated projectiles instead of instant line traces */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile")
+	bool bUseProjectiles = false;
+
+	/** The speed (in cm/s) at which projectiles leave the barrel */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile", meta = (EditCondition = "bUseProjectiles"))
+	float MuzzleVelocity = 40000.0f;
+
+	/** The multiplier applied to the world's gravity for projectiles fired by this weapon */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile", meta = (EditCondition = "bUseProjectiles"))
+	float ProjectileGravityScale = 1.0f;
+
+	/** The fraction of its velocity that a projectile loses every second to air resistance */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile", meta = (EditCondition = "bUseProjectiles", ClampMin = "0.0"))
+	float ProjectileDrag = 0.0f;
+
+	/** The time (in seconds) after which a projectile that has not hit anything is removed */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile", meta = (EditCondition = "bUseProjectiles"))
+	float ProjectileLifetime = 3.0f;
+
 	/** Attachments */
 
 	/** Whether this weapon has a unique set of attachments and is broken up into multiple meshes or is unique */
@@ -493,6 +581,11 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
 	bool bIsShotgun = false;
 
+	/** The durations of the weapon's actions. Any duration left at 0 is baked from the length of its animation when the
+	 *	weapon is loaded (see AWeaponBase::GetActionDurations) */
+	UPROPERTY(EditDefaultsOnly, Category = "Timing")
+	FWeaponActionDurations ActionDurations;
+
 	/** Whether the player's FOV should change when aiming with this weapon */
 	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
 	bool bAimingFOV = false;
@@ -530,8 +623,8 @@ struct FStaticWeaponData : public FTableRowBase
 	int ClipSize;
 
 	/** The rate of fire (In rounds per minute/RPM) of the weapon */
-	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
-	float RateOfFire;
+	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)", meta = (ClampMin = "1"))
+	float RateOfFire = 600.0f;
 
 	/** Whether this weapon supports automatic fire */
 	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
@@ -553,8 +646,8 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
 	float ShotgunRange;
 
-	/** The amount of pellets fired */
-	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)")
+	/** The amount of pellets fired (at most 255, as pellets are indexed by a byte when replicated) */
+	UPROPERTY(EditDefaultsOnly, Category = "Unique Weapon (No Attachments)", meta = (ClampMax = 255))
 	int ShotgunPellets;
 
 	/** The increase in shot variation when the player is not aiming down the sights */
@@ -563,6 +656,11 @@ struct FStaticWeaponData : public FTableRowBase
 
 	/** Damage surfaces */
 
+	/** The table (of FSurfaceResponse rows) holding the impact effect, sound and damage multiplier for every physical
+	 *	surface type. Surfaces that are not in the table fall back to the surfaces below */
+	UPROPERTY(EditDefaultsOnly, Category = "Damage Surfaces")
+	UDataTable *SurfaceResponseTable;
+
 	/** surface (physical material) for areas which should spawn blood particles when hit and receive normal damage (equivalent to the baseDamage variable) */
 	UPROPERTY(EditDefaultsOnly, Category = "Damage Surfaces")
 	UPhysicalMaterial *NormalDamageSurface;
@@ -579,45 +677,68 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Damage Surfaces")
 	UPhysicalMaterial *RockSurface;
 
-	/** VFX */
+	/** VFX (soft references, so that dedicated servers never load them. See AWeaponBase::LoadCosmetics) */
 
 	/** particle effect (Niagara system) to be spawned when an enemy is hit */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *EnemyHitEffect;
+	TSoftObjectPtr<UNiagaraSystem> EnemyHitEffect;
 
 	/** particle effect (Niagara system) to be spawned when the ground is hit */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *GroundHitEffect;
+	TSoftObjectPtr<UNiagaraSystem> GroundHitEffect;
 
 	/** particle effect (Niagara system) to be spawned when a rock is hit */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *RockHitEffect;
+	TSoftObjectPtr<UNiagaraSystem> RockHitEffect;
 
 	/** particle effect (Niagara system) to be spawned when no defined type is hit */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *DefaultHitEffect;
+	TSoftObjectPtr<UNiagaraSystem> DefaultHitEffect;
 
 	/** particle effect to be spawned at the muzzle when a shot is fired */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *MuzzleFlash;
+	TSoftObjectPtr<UNiagaraSystem> MuzzleFlash;
 
 	/** particle effect to be spawned at the muzzle that shows the path of the bullet */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX")
-	UNiagaraSystem *BulletTrace;
+	TSoftObjectPtr<UNiagaraSystem> BulletTrace;
+
+	/** The amount of components prewarmed in the weapon effect pool for each of this weapon's effects (tracers and
+	 *	impacts are multiplied by the amount of pellets). Check the pool's misses and peak to size this */
+	UPROPERTY(EditDefaultsOnly, Category = "VFX")
+	int32 EffectPoolSize = 4;
 
-	/** Sound bases */
+	/** Sound bases (soft references, so that dedicated servers never load them) */
 
 	/** Firing sound */
 	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
-	USoundBase *FireSound;
+	TSoftObjectPtr<USoundBase> FireSound;
 
 	/** Silenced firing sound */
 	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
-	USoundBase *SilencedSound;
+	TSoftObjectPtr<USoundBase> SilencedSound;
 
 	/** Empty firing sound */
 	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
-	USoundBase *EmptyFireSound;
+	TSoftObjectPtr<USoundBase> EmptyFireSound;
+
+	/** Looping firing sound, played instead of FireSound for as long as a high rate of fire automatic weapon keeps firing
+	 *	(see FPSCore.WeaponFireLoopRateOfFire) */
+	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
+	TSoftObjectPtr<USoundBase> FireLoopSound;
+
+	/** Sound played when FireLoopSound starts, layered over the start of the loop to give the first shot its attack */
+	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
+	TSoftObjectPtr<USoundBase> FireStartSound;
+
+	/** Sound played when FireLoopSound stops */
+	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
+	TSoftObjectPtr<USoundBase> FireTailSound;
+
+	/** Concurrency limits of this weapon's sounds. When not set, every weapon class shares a default limit between its
+	 *	instances (see FPSCore.WeaponSoundVoicesPerClass) */
+	UPROPERTY(EditDefaultsOnly, Category = "Sound bases	")
+	USoundConcurrency *SoundConcurrency;
 
 	/** Viewport Appearance */
 
@@ -630,11 +751,94 @@ struct FStaticWeaponData : public FTableRowBase
 	UTexture2D *WeaponIcon;
 };
 
+/** A pellet (or bullet) which hit something, sent as part of an FWeaponImpactBatch. Pellets which do not hit anything
+ *	are not sent at all, as clients can rebuild their direction from the shot's seed */
+USTRUCT()
+struct FWeaponImpact
+{
+	GENERATED_BODY()
+
+	/** The index of the pellet within its shot */
+	UPROPERTY()
+	uint8 PelletIndex = 0;
+
+	/** The distance travelled by the pellet along its direction before hitting something */
+	UPROPERTY()
+	float Distance = 0.0f;
+
+	/** The component that was hit, used to attach the impact effect */
+	UPROPERTY()
+	UPrimitiveComponent *HitComponent = nullptr;
+
+	/** The index of the weapon's response to the surface that was hit, used to select the impact effect. See
+	 *	AWeaponBase::GetSurfaceResponseIndex */
+	UPROPERTY()
+	uint8 SurfaceResponse = SurfaceType_Default;
+};
+
+/** A single trigger pull, sent to clients in a single multicast. Holds everything needed to rebuild the direction of
+ *	every pellet with FWeaponSpread, along with the pellets that hit something */
+USTRUCT()
+struct FWeaponImpactBatch
+{
+	GENERATED_BODY()
+
+	/** Where the shot was fired from */
+	UPROPERTY()
+	FVector_NetQuantize10 Origin;
+
+	/** Where the shot was aimed, before spread (quantized with FWeaponSpread::QuantizeAim) */
+	UPROPERTY()
+	FRotator Aim = FRotator::ZeroRotator;
+
+	/** The ID of the shot, from which its spread seed is derived */
+	UPROPERTY()
+	uint16 ShotId = 0;
+
+	/** The maximum pitch deviation of the pellets (quantized with FWeaponSpread::QuantizeSpread) */
+	UPROPERTY()
+	uint16 PitchSpread = 0;
+
+	/** The maximum yaw deviation of the pellets (quantized with FWeaponSpread::QuantizeSpread) */
+	UPROPERTY()
+	uint16 YawSpread = 0;
+
+	/** The pellets that hit something, in pellet order */
+	UPROPERTY()
+	TArray<FWeaponImpact> Impacts;
+};
+
+/** The server's view of a weapon after its latest shot, sent to the owning client to reconcile predicted shots against */
+USTRUCT()
+struct FConfirmedShotState
+{
+	GENERATED_BODY()
+
+	/** The ID of the latest shot processed by the server */
+	UPROPERTY()
+	uint16 ShotId = 0;
+
+	/** The amount of ammunition left in the magazine after that shot */
+	UPROPERTY()
+	int32 ClipSize = 0;
+
+	/** Whether the server is currently reloading the weapon */
+	UPROPERTY()
+	bool bIsReloading = false;
+
+	/** Incremented whenever the server refuses the shot IDs of the owning client, which then adopts ShotId as its own */
+	UPROPERTY()
+	uint8 ResyncCount = 0;
+};
+
 UCLASS()
 class FPSCORE_API AWeaponBase : public AActor
 {
 	GENERATED_BODY()
 
+	/** Traces shots on behalf of the weapon, and then applies their damage and multicasts their impacts */
+	friend class UShotResolverSubsystem;
+
 public:
 	/** Returns the Current Animation Delay Active */
 	FTimerHandle &GetAnimationWaitDelay() { return AnimationWaitDelay; }
@@ -645,18 +849,44 @@ public:
 	/** Update the weapon's runtime weapon data
 	 *	@param NewWeaponData The weapons new runtime weapon data
 	 */
-	void SetRuntimeWeaponData(const FRuntimeWeaponData NewWeaponData) { GeneralWeaponData = NewWeaponData; }
+	void SetRuntimeWeaponData(const FRuntimeWeaponData NewWeaponData)
+	{
+		GeneralWeaponData = NewWeaponData;
+		ConfirmShotState();
+	}
 
 	/** Returns a reference to the static weapon data of the weapon */
 	FStaticWeaponData *GetStaticWeaponData() { return &WeaponData; }
 
+	/** Returns how long each of the weapon's actions takes, with the current attachments */
+	UFUNCTION(BlueprintPure, Category = "Weapon Base")
+	const FWeaponActionDurations &GetActionDurations() const { return ActionDurations; }
+
 	/** Updates the weapon's static weapon data
 	 *	@param NewWeaponData The weapon's new static weapon data
 	 */
-	void SetStaticWeaponData(const FStaticWeaponData NewWeaponData) { WeaponData = NewWeaponData; }
+	void SetStaticWeaponData(const FStaticWeaponData NewWeaponData);
+
+	/** Starts firing the gun (sets the timer for automatic fire)
+	 *	@param ShotTimestamp The server time at which the shooter saw the world, used to rewind other players on the server
+	 *	@param FirstShotId The ID the shooter gave to the first shot of this burst when predicting it
+	 */
+	void StartFire(FVector CameraLocation, FRotator CameraRotation, double ShotTimestamp, uint16 FirstShotId);
+
+	/** Starts firing the gun locally on the owning client, ahead of the server (sets the timer for automatic fire) */
+	void StartPredictedFire(FVector CameraLocation, FRotator CameraRotation);
+
+	/** Marks every shot up to the given ID as processed by the server, even those it refused to fire (server only). IDs
+	 *	more than MaxSkippedShots ahead of the server's are refused, and the owning client is made to adopt the server's */
+	void AcknowledgeShots(uint16 ClientShotId);
+
+	/** Called by the projectile subsystem when a projectile fired by this weapon hits something
+	 *	@param bAuthoritative Whether the projectile was simulated by the server and should deal damage
+	 */
+	void OnProjectileHit(const FHitResult &HitResult, const FVector &Direction, bool bAuthoritative);
 
-	/** Starts firing the gun (sets the timer for automatic fire) */
-	void StartFire(FVector CameraLocation, FRotator CameraRotation);
+	/** Returns the ID of the latest shot fired (predicted, on the owning client) */
+	uint16 GetLastShotId() const { return LastShotId; }
 
 	/** Stops the timer that allows for automatic fire */
 	void StopFire();
@@ -675,6 +905,16 @@ public:
 	 */
 	void SetCanFire(const bool bNewFire) { bCanFire = bNewFire; }
 
+	/** Hides or shows the weapon when it is put away or taken out. Holstered weapons unregister their tick and, on the server,
+	 *	go dormant until they are taken out again
+	 *	@param bHolstered Whether the weapon is being put away
+	 */
+	void SetHolstered(bool bHolstered);
+
+	/** Weapons are relevant to the connections that their owner is relevant to, within NetCullDistanceSquared. The FPS Core
+	 *	replication graph never calls this, and replicates weapons along with their owner instead */
+	virtual bool IsNetRelevantFor(const AActor *RealViewer, const AActor *ViewTarget, const FVector &SrcLocation) const override;
+
 	/** Update the weapon's ability to reload
 	 *	@param bNewReload The new state of the weapon's ability to reload
 	 */
@@ -688,8 +928,11 @@ public:
 	 */
 	void SetShouldRecover(const bool bNewShouldRecover) { bShouldRecover = bNewShouldRecover; }
 
-	/** A reference to the recoil recovery timeline */
-	FTimeline *GetRecoilRecoveryTimeline() { return &RecoilRecoveryTimeline; }
+	/** Stops recovering from recoil, leaving the view where it currently is */
+	void StopRecoilRecovery() { bIsRecovering = false; }
+
+	/** Returns the baked recoil of this weapon, with the recoil multipliers of its attachments applied */
+	const FWeaponRecoilTable &GetRecoilTable() const { return RecoilTable; }
 
 	/** A reference to the key name of the Weapon Data datatable */
 	FString GetDataTableNameRef() const { return DataTableNameRef; }
@@ -698,6 +941,7 @@ public:
 	void SetShowDebug(const bool IsVisible)
 	{
 		bShowDebug = IsVisible;
+		UpdateTickEnabled();
 	};
 
 	/** Returns the character's set of animations */
@@ -767,12 +1011,17 @@ public:
 	void HandleUnequip(UInventoryComponent *InventoryComponent);
 	void HandleUnequip_Implementation(UInventoryComponent *InventoryComponent);
 
+	/** Keeps the weapon from firing until it has been taken out, for the baked equip duration */
+	UFUNCTION(NetMulticast, Reliable)
+	void HandleEquip();
+	void HandleEquip_Implementation();
+
 protected:
-	/** Multicast of the firing function */
+	/** Multicast of the firing function, carrying the impacts of every pellet fired by a single shot */
 	UFUNCTION(NetMulticast, Reliable, WithValidation)
-	void Multi_Fire(FHitResult HitResult);
-	bool Multi_Fire_Validate(FHitResult HitResult);
-	void Multi_Fire_Implementation(FHitResult HitResult);
+	void Multi_Fire(const FWeaponImpactBatch &ImpactBatch);
+	bool Multi_Fire_Validate(const FWeaponImpactBatch &ImpactBatch);
+	void Multi_Fire_Implementation(const FWeaponImpactBatch &ImpactBatch);
 
 	/** Multicast of the firing function for things that shouldn't run more than once in case of shotguns */
 	UFUNCTION(NetMulticast, Reliable, WithValidation)
@@ -792,30 +1041,6 @@ protected:
 	bool Multi_Reload_Validate();
 	void Multi_Reload_Implementation();
 
-	/** RPC of the StartRecoil function */
-	UFUNCTION(Client, Reliable, WithValidation)
-	void Client_StartRecoil();
-	bool Client_StartRecoil_Validate();
-	void Client_StartRecoil_Implementation();
-
-	/** RPC of the Recoil function */
-	UFUNCTION(Client, Reliable, WithValidation)
-	void Client_Recoil();
-	bool Client_Recoil_Validate();
-	void Client_Recoil_Implementation();
-
-	/** RPC of the RecoilRecovery function */
-	UFUNCTION(Client, Reliable, WithValidation)
-	void Client_RecoilRecovery();
-	bool Client_RecoilRecovery_Validate();
-	void Client_RecoilRecovery_Implementation();
-
-	/** RPC of the RecoilRecovery function */
-	UFUNCTION(Client, Reliable, WithValidation)
-	void Client_HandleRecoveryProgress(float Value) const;
-	bool Client_HandleRecoveryProgress_Validate(float Value) const;
-	void Client_HandleRecoveryProgress_Implementation(float Value) const;
-
 	/** The skeletal mesh used to hold the current barrel attachment */
 	UPROPERTY(BlueprintReadOnly, Category = "Components")
 	USkeletalMeshComponent *BarrelAttachment;
@@ -836,6 +1061,14 @@ protected:
 	UPROPERTY(BlueprintReadOnly, Category = "Components")
 	USkeletalMeshComponent *GripAttachment;
 
+	/** The server's state after the latest shot, replicated to the owning client for reconciliation */
+	UPROPERTY(ReplicatedUsing = OnRep_ConfirmedShot)
+	FConfirmedShotState ConfirmedShot;
+
+	/** Corrects the predicted ammunition and reload state using the server's confirmed state */
+	UFUNCTION()
+	void OnRep_ConfirmedShot();
+
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty> &OutLifetimeProps) const;
 
 	void PreInitializeComponents();
@@ -846,8 +1079,92 @@ private:
 	/** Sets default values for this actor's properties */
 	AWeaponBase();
 
-	/** Spawns the line trace that deals damage and applies sound/visual effects */
-	void Fire(FVector CameraLocation, FRotator CameraRotation);
+	/** Spawns the line trace that deals damage and applies sound/visual effects
+	 *	@param ShotTime The server time at which the shot was due, used to rewind other players
+	 */
+	void Fire(FVector CameraLocation, FRotator CameraRotation, double ShotTime);
+
+	/** Fires the first shot and starts the fire scheduler, which keeps firing from Tick while the trigger is held */
+	void BeginFiring(const FVector &CameraLocation, const FRotator &CameraRotation);
+
+	/** Fires every shot due within the last DeltaTime seconds (since the trigger pull, at most), interpolating the aim of
+	 *	each shot between the previous frame's aim and the given one */
+	void RunFireScheduler(float DeltaTime, const FVector &AimLocation, const FQuat &AimRotation);
+
+	/** Returns the owner's current camera location and control rotation */
+	void GetCurrentAim(FVector &OutLocation, FRotator &OutRotation) const;
+
+	/** Fires a shot locally on the owning client, playing its effects without dealing damage */
+	void PredictFire(FVector CameraLocation, FRotator CameraRotation);
+
+	/** Fills in the parameters of a shot (origin, aim, shot ID and spread) from which every pellet is generated */
+	void PrepareShot(const FVector &CameraLocation, const FRotator &CameraRotation, FWeaponImpactBatch &OutImpactBatch) const;
+
+	/** Returns the direction of a single pellet of a shot prepared by PrepareShot() */
+	FRotator GetPelletRotation(const FWeaponImpactBatch &ImpactBatch, int32 PelletIndex) const;
+
+	/** Returns the amount of pellets fired by every shot, capped to what FWeaponImpact::PelletIndex can address */
+	int32 GetNumPellets() const { return WeaponData.bIsShotgun ? FMath::Min(WeaponData.ShotgunPellets, static_cast<int32>(MAX_uint8)) : 1; }
+
+	/** Returns the length of the line trace of every pellet */
+	float GetShotRange() const { return WeaponData.bIsShotgun ? WeaponData.ShotgunRange : WeaponData.LengthMultiplier; }
+
+	/** Traces every pellet of a single shot (or spawns it as a projectile), using the spread generated from the shot's seed
+	 *	@param bAuthoritative Whether to apply damage and broadcast hits (false when predicting)
+	 *	@param OutImpactBatch Filled with the shot's parameters and the pellets that hit something
+	 */
+	void TracePellets(const FVector &CameraLocation, const FRotator &CameraRotation, bool bAuthoritative, FWeaponImpactBatch &OutImpactBatch);
+
+	/** Applies damage to whatever a shot hit and broadcasts the hit, shared by line traces and projectiles (server only) */
+	void ApplyHitDamage(const FHitResult &HitResult, const FVector &ShotDirection);
+
+	/** Flattens the surface response table and the legacy surface fields into SurfaceResponses */
+	void BuildSurfaceResponses();
+
+	/** Returns the index in SurfaceResponses of this weapon's response to hitting the given physical material. This is the
+	 *	material's surface type, unless it is a legacy surface field without one */
+	int32 GetSurfaceResponseIndex(const UPhysicalMaterial *PhysMaterial) const;
+
+	/** Returns how this weapon responds to hitting a surface, given the index of its response. Weapons which have not
+	 *	built their responses yet respond to everything with the default response */
+	const FSurfaceResponse &GetSurfaceResponse(int32 ResponseIndex) const;
+
+	/** Prewarms the weapon effect pool with every effect that this weapon can play */
+	void PrewarmEffects();
+
+	/** Asynchronously loads the effects and sounds of the weapon and its surface responses, except on dedicated servers.
+	 *	Cosmetics are skipped until they have loaded */
+	void LoadCosmetics();
+
+	/** Prewarms the weapon's effects once LoadCosmetics has loaded them */
+	void OnCosmeticsLoaded();
+
+	/** Handles recoil recovery for manual weapons and waits for the shot animation to finish if needed */
+	void CycleShot();
+
+	/** Spawns tracers, casings and impact effects for a shot */
+	void PlayImpactEffects(const FWeaponImpactBatch &ImpactBatch);
+
+	/** Plays the impact effect and sound of a surface which has been hit, batching the effect when the surface allows it */
+	void PlaySurfaceImpact(const FSurfaceResponse &Response, USceneComponent *HitComponent, const FVector &Location, const FVector &Normal);
+
+	/** Plays the weapon and player animations, muzzle flash and firing sound of a shot */
+	void PlayFireEffects();
+
+	/** Plays the empty firing sound and stops the firing timer */
+	void PlayEmptyFireEffects();
+
+	/** Whether this is the owning client of the weapon, which predicts its own shots */
+	bool IsLocallyPredicting() const;
+
+	/** Whether the weapon is held by a locally controlled player, which applies and recovers from its own recoil */
+	bool IsOwnerLocallyControlled() const;
+
+	/** Returns the mesh that this weapon's sounds are played from */
+	USceneComponent *GetSoundSourceComponent() const;
+
+	/** Updates ConfirmedShot with the current ammunition and reload state (server only) */
+	void ConfirmShotState();
 
 	/** Applies recoil to the player controller */
 	void Recoil();
@@ -867,16 +1184,35 @@ private:
 	/** Initiates the recoil function */
 	void RecoilRecovery();
 
+	/** Moves the view along the recovery curve, and ends the recovery once the curve has been played */
+	void UpdateRecoilRecovery();
+
 	/** Interpolates the player back to their initial view vector */
-	UFUNCTION()
 	void HandleRecoveryProgress(float Value) const;
 
+	/** Bakes the recoil and recovery curves, with the modifiers of the current attachments, into lookup tables */
+	void BakeRecoil();
+
+	/** Bakes the durations of the weapon's actions from WeaponData, and from the animations of the current attachments */
+	void BakeActionDurations();
+
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
 
-	/** Called every frame */
+	/** Called when the weapon is destroyed or removed from the world */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Called every frame while the weapon is firing or recovering from recoil */
 	virtual void Tick(float DeltaTime) override;
 
+	/** Reattaches the weapon to its new owner's meshes */
+	virtual void SetOwner(AActor *NewOwner) override;
+	virtual void OnRep_Owner() override;
+
+	/** Enables the weapon's tick while it has anything to update (firing, recovering from recoil or showing debug
+	 *	messages), and disables it otherwise, so that idle and holstered weapons cost nothing per frame */
+	void UpdateTickEnabled();
+
 	bool ShotGunFiredFirstShot = false;
 
 #pragma endregion
@@ -914,7 +1250,19 @@ private:
 
 	/** The ejected casing particle effect to be played after each shot */
 	UPROPERTY(EditDefaultsOnly, Category = "Particles")
-	UNiagaraSystem *EjectedCasing;
+	TSoftObjectPtr<UNiagaraSystem> EjectedCasing;
+
+	/** The handle of the effects and sounds requested by LoadCosmetics, which keeps them loaded for as long as the weapon
+	 *	exists (or until its data changes) */
+	TSharedPtr<FStreamableHandle> CosmeticsHandle;
+
+	/** How often (per second) the weapon is considered for replication while it is not being fired */
+	UPROPERTY(EditDefaultsOnly, Category = "Replication")
+	float IdleNetUpdateFrequency = 2.0f;
+
+	/** How often (per second) the weapon is considered for replication while it is being fired */
+	UPROPERTY(EditDefaultsOnly, Category = "Replication")
+	float FiringNetUpdateFrequency = 30.0f;
 
 #pragma endregion
 
@@ -978,8 +1326,44 @@ private:
 	/** internal variable used to keep track of the final damage value after modifications */
 	float FinalDamage;
 
-	/** The timer that handles automatic fire */
-	FTimerHandle ShotDelay;
+	/** How far back in time (in seconds) other players are rewound when tracing shots, set from the shooter's timestamp */
+	double RewindTimeOffset = 0.0;
+
+	/** The response to every physical surface type, indexed by EPhysicalSurface, followed by the responses to the legacy
+	 *	surface fields which have no surface type (built from WeaponData in BeginPlay and SetStaticWeaponData) */
+	UPROPERTY()
+	TArray<FSurfaceResponse> SurfaceResponses;
+
+	/** The index in SurfaceResponses of every legacy surface material without a surface type. The materials are kept
+	 *	loaded by the weapon data table that references them */
+	TMap<const UPhysicalMaterial *, int32> UntypedSurfaceResponses;
+
+	/** The ID of the latest shot fired. On the owning client this includes shots which have not been confirmed yet */
+	uint16 LastShotId = 0;
+
+	/** How many shots the owning client can be ahead of the server when starting or stopping fire. The server only falls
+	 *	behind by the shots it refused to fire, and shot IDs select the spread of shots, so clients cannot skip further */
+	static constexpr int32 MaxSkippedShots = 4;
+
+	/** The latest ConfirmedShot.ResyncCount handled by the owning client */
+	uint8 LastResyncCount = 0;
+
+	/** The seed used, alongside shot IDs, to generate the spread of every shot fired by this weapon */
+	UPROPERTY(Replicated)
+	uint32 SpreadSeed = 0;
+
+	/** Whether the fire scheduler should keep firing (cleared after the first shot for non-automatic weapons) */
+	bool bTriggerHeld = false;
+
+	/** The time, from the start of the current frame, until the fire scheduler is due to fire its next shot */
+	double TimeUntilNextShot = 0.0;
+
+	/** The world time at which the trigger was last pulled, before which the fire scheduler never fires */
+	double TriggerPullTime = 0.0;
+
+	/** The aim at the end of the previous frame, which shots fired during the current frame are interpolated from */
+	FVector LastAimLocation;
+	FQuat LastAimRotation;
 
 	/** The timer that is used when we need to wait for an animation to finish before being able to fire again */
 	FTimerHandle AnimationWaitDelay;
@@ -990,22 +1374,29 @@ private:
 	/** The timer used to keep track of whether to  */
 	FTimerHandle SpamFirePreventionDelay;
 
-	/** The curve for vertical recoil (set from WeaponData) */
-	UPROPERTY()
-	UCurveFloat *VerticalRecoilCurve;
+	/** The timer used to keep track of how long the weapon takes to be taken out */
+	FTimerHandle EquipDelay;
 
-	/** The timeline for vertical recoil (generated from the curve) */
-	FTimeline VerticalRecoilTimeline;
+	/** The recoil curves of WeaponData, baked with the recoil modifiers applied */
+	FWeaponRecoilTable RecoilTable;
 
-	/** The curve for horizontal recoil (set from WeaponData) */
-	UPROPERTY()
-	UCurveFloat *HorizontalRecoilCurve;
+	/** The recovery curve, baked */
+	FBakedRecoilCurve RecoveryTable;
+
+	/** The durations of the weapon's actions, baked by BakeActionDurations */
+	FWeaponActionDurations ActionDurations;
+
+	/** The duration of a reload when the weapon has no reload animation to time it from */
+	static constexpr float DefaultReloadDuration = 2.0f;
+
+	/** The world time at which the current recovery started */
+	double RecoveryStartTime = 0.0;
 
-	/** The timeline for horizontal recoil (generated from the curve) */
-	FTimeline HorizontalRecoilTimeline;
+	/** Whether we are currently recovering from recoil */
+	bool bIsRecovering = false;
 
-	/** The timeline for recover (set from the curve) */
-	FTimeline RecoilRecoveryTimeline;
+	/** Whether the weapon is currently put away */
+	bool bIsHolstered = false;
 
 	/** A value to temporarily cache the player's control rotation so that we can return to it */
 	FRotator ControlRotation;
@@ -1013,7 +1404,7 @@ private:
 	/** Keeping track of whether we should do a recoil recovery after finishing firing or not */
 	bool bShouldRecover;
 
-	/** Used in recoil to make sure the first shot has properly applied recoil */
+	/** The number of shots fired since the burst started, which is the index of the next shot in the recoil table */
 	int ShotsFired;
 
 	/** The base multiplier for vertical recoil, modified by attachments */
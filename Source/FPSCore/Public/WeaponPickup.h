@@ -90,6 +90,14 @@ private:
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
 
+	/** Makes pickups that simulate physics dormant once they have come to rest (server only) */
+	UFUNCTION()
+	void OnMeshSleep(UPrimitiveComponent *SleepingComponent, FName BoneName);
+
+	/** Wakes pickups that simulate physics up again when they are set in motion (server only) */
+	UFUNCTION()
+	void OnMeshWake(UPrimitiveComponent *WakingComponent, FName BoneName);
+
 	/** Meshes for Attachments */
 
 	UPROPERTY()
@@ -0,0 +1,100 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCurveFloat;
+
+/** A float curve baked into a fixed number of evenly spaced samples. Evaluating it is a clamped lookup and a lerp, with no
+ *	key search, tangent maths or state, so it is cheap to evaluate many times and safe to evaluate from any thread. Like
+ *	the curves it is baked from, it holds its first and last values before and after its time range.
+ */
+struct FPSCORE_API FBakedRecoilCurve
+{
+	/** The number of samples taken from the curve */
+	static constexpr int32 NumSamples = 64;
+
+	/** Samples the curve over its time range, scaling every sample by Multiplier. Without a curve, every sample is zero */
+	void Bake(const UCurveFloat *Curve, float Multiplier = 1.0f);
+
+	/** Returns the (scaled) value of the curve at the given time */
+	float Evaluate(const float Time) const
+	{
+		const float Position = FMath::Clamp((Time - StartTime) * InvSampleInterval, 0.0f, static_cast<float>(NumSamples - 1));
+		const int32 Index = FMath::Min(static_cast<int32>(Position), NumSamples - 2);
+		return FMath::Lerp(Samples[Index], Samples[Index + 1], Position - Index);
+	}
+
+	/** Returns the time of the last key of the curve */
+	float GetEndTime() const { return EndTime; }
+
+private:
+	/** The samples, evenly spaced between StartTime and EndTime */
+	alignas(16) float Samples[NumSamples] = {};
+
+	/** The time of the first key of the curve */
+	float StartTime = 0.0f;
+
+	/** The time of the last key of the curve */
+	float EndTime = 0.0f;
+
+	/** The number of samples per second (zero for curves with a single key) */
+	float InvSampleInterval = 0.0f;
+};
+
+/** The recoil of a weapon, baked from its recoil curves with the recoil multipliers of its attachments already applied.
+ *
+ *	The recoil of a shot is a pure function of its index within the burst: shot N is fired N shot intervals after the burst
+ *	started (see AWeaponBase::RunFireScheduler), and kicks the view by the value of the curves at that time. Nothing needs
+ *	to be ticked between shots, and bots or simulators can evaluate the recoil of thousands of shots with EvaluateShots().
+ */
+struct FPSCORE_API FWeaponRecoilTable
+{
+	/** Bakes the recoil curves of a weapon
+	 *	@param VerticalCurve The curve of the pitch input applied by each shot
+	 *	@param HorizontalCurve The curve of the yaw input applied by each shot
+	 *	@param VerticalMultiplier The multiplier applied to the vertical curve by attachments
+	 *	@param HorizontalMultiplier The multiplier applied to the horizontal curve by attachments
+	 *	@param RateOfFire The rate of fire of the weapon, in rounds per minute
+	 */
+	void Bake(const UCurveFloat *VerticalCurve, const UCurveFloat *HorizontalCurve, float VerticalMultiplier, float HorizontalMultiplier, float RateOfFire);
+
+	/** Whether the weapon has both recoil curves, and so applies any recoil */
+	bool IsValid() const { return bIsValid; }
+
+	/** Returns the pitch and yaw input applied by the recoil at the given time since the burst started */
+	void Evaluate(const float Time, float &OutPitch, float &OutYaw) const
+	{
+		OutPitch = Vertical.Evaluate(Time);
+		OutYaw = Horizontal.Evaluate(Time);
+	}
+
+	/** Returns the pitch and yaw input applied by the shot with the given index within the burst */
+	void EvaluateShot(const int32 ShotIndex, float &OutPitch, float &OutYaw) const
+	{
+		Evaluate(ShotIndex * ShotInterval, OutPitch, OutYaw);
+	}
+
+	/** Returns the pitch and yaw inputs of NumShots consecutive shots, starting with the shot at FirstShotIndex */
+	void EvaluateShots(const int32 FirstShotIndex, const int32 NumShots, float *OutPitch, float *OutYaw) const
+	{
+		for (int32 Shot = 0; Shot < NumShots; ++Shot)
+		{
+			EvaluateShot(FirstShotIndex + Shot, OutPitch[Shot], OutYaw[Shot]);
+		}
+	}
+
+private:
+	/** The pitch input of the recoil over time */
+	FBakedRecoilCurve Vertical;
+
+	/** The yaw input of the recoil over time */
+	FBakedRecoilCurve Horizontal;
+
+	/** The time between two shots, in seconds */
+	float ShotInterval = 0.0f;
+
+	/** Whether the weapon has both recoil curves */
+	bool bIsValid = false;
+};
@@ -0,0 +1,90 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Deterministic, stateless weapon spread. Every random value is a pure function of a seed and a counter (a counter-based
+ *	hash), so the server, the shooting client and remote clients all build the exact same pellet directions from a shot's
+ *	seed without sharing any random number generator state. Being stateless, it is also safe to call from worker threads.
+ *
+ *	Inputs that go over the network (aim, origin and spread) are quantized with the same precision that they are
+ *	replicated with, and the server fires using the quantized values, so that every machine traces identical rays.
+ */
+struct FWeaponSpread
+{
+	/** The precision, in degrees, at which spread angles are replicated */
+	static constexpr float SpreadQuantum = 0.01f;
+
+	/** Mixes a 32-bit value into a well-distributed 32-bit hash */
+	static uint32 Mix(uint32 Value)
+	{
+		Value ^= Value >> 16;
+		Value *= 0x7feb352dU;
+		Value ^= Value >> 15;
+		Value *= 0x846ca68bU;
+		Value ^= Value >> 16;
+		return Value;
+	}
+
+	/** Returns the random value number Counter of the stream identified by Seed */
+	static uint32 Hash(const uint32 Seed, const uint32 Counter)
+	{
+		return Mix(Seed ^ Mix(Counter + 0x9e3779b9U));
+	}
+
+	/** Returns a random float in the range [-1, 1) */
+	static float SignedUnit(const uint32 Seed, const uint32 Counter)
+	{
+		// Using the top 24 bits, which is all the precision a float mantissa can hold
+		return static_cast<float>(Hash(Seed, Counter) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+	}
+
+	/** Returns the seed of a single shot, derived from the weapon's replicated seed and the ID of the shot */
+	static uint32 GetShotSeed(const uint32 WeaponSeed, const uint16 ShotId)
+	{
+		return Hash(WeaponSeed, ShotId);
+	}
+
+	/** Returns the direction of a single pellet
+	 *	@param Aim The (quantized) aim of the shot
+	 *	@param ShotSeed The seed of the shot, from GetShotSeed()
+	 *	@param PelletIndex The index of the pellet within the shot
+	 *	@param PitchSpread The maximum pitch deviation in degrees, either side of the aim
+	 *	@param YawSpread The maximum yaw deviation in degrees, either side of the aim
+	 */
+	static FRotator GetPelletRotation(const FRotator &Aim, const uint32 ShotSeed, const int32 PelletIndex, const float PitchSpread, const float YawSpread)
+	{
+		FRotator PelletRotation = Aim;
+		PelletRotation.Pitch += SignedUnit(ShotSeed, PelletIndex * 2) * PitchSpread;
+		PelletRotation.Yaw += SignedUnit(ShotSeed, PelletIndex * 2 + 1) * YawSpread;
+		return PelletRotation;
+	}
+
+	/** Quantizes a spread angle for replication */
+	static uint16 QuantizeSpread(const float Degrees)
+	{
+		return static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Degrees / SpreadQuantum), 0, static_cast<int32>(MAX_uint16)));
+	}
+
+	/** Restores a spread angle from its quantized value */
+	static float DequantizeSpread(const uint16 Quantized)
+	{
+		return Quantized * SpreadQuantum;
+	}
+
+	/** Rounds an aim rotation to the precision at which FRotator is replicated (16 bits per axis, no roll) */
+	static FRotator QuantizeAim(const FRotator &Aim)
+	{
+		return FRotator(
+			FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Aim.Pitch)),
+			FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Aim.Yaw)),
+			0.0f);
+	}
+
+	/** Rounds a shot origin to the precision of FVector_NetQuantize10 */
+	static FVector QuantizeOrigin(const FVector &Origin)
+	{
+		return FVector(FMath::RoundToDouble(Origin.X * 10.0) / 10.0, FMath::RoundToDouble(Origin.Y * 10.0) / 10.0, FMath::RoundToDouble(Origin.Z * 10.0) / 10.0);
+	}
+};
@@ -0,0 +1,5 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, FPSCoreEditor)
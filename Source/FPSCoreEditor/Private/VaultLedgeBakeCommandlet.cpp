@@ -0,0 +1,322 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#include "VaultLedgeBakeCommandlet.h"
+#include "FPSCharacter.h"
+#include "VaultLedges.h"
+#include "Components/ModelComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVaultLedgeBake, Log, All);
+
+namespace
+{
+	/** The most surfaces that are looked for in a single column */
+	constexpr int32 MaxTracesPerColumn = 32;
+
+	/** The directions in which characters approach edges */
+	const FVector ApproachDirections[] = { FVector::ForwardVector, FVector::BackwardVector, FVector::RightVector, FVector::LeftVector };
+
+	/** Returns the parameters that every bake trace is performed with, matching the ones of characters but only hitting
+	 *	static geometry. Stationary components have static bodies as well, so they are hit too */
+	FCollisionQueryParams GetBakeQueryParams()
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(VaultLedgeBake), true);
+		QueryParams.MobilityType = EQueryMobilityType::Static;
+		return QueryParams;
+	}
+
+	/** Whether a component blocks the traces of characters */
+	bool BlocksCharacterTraces(const UPrimitiveComponent *Component)
+	{
+		return Component->IsRegistered() && Component->IsCollisionEnabled() && Component->GetCollisionResponseToChannel(ECC_WorldStatic) == ECR_Block;
+	}
+
+	/** Whether a component is static or stationary geometry that blocks the traces of characters */
+	bool IsBakedGeometry(const UPrimitiveComponent *Component)
+	{
+		return Component->Mobility != EComponentMobility::Movable && BlocksCharacterTraces(Component);
+	}
+}
+
+UVaultLedgeBakeCommandlet::UVaultLedgeBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UVaultLedgeBakeCommandlet::Main(const FString &Params)
+{
+	FString Maps;
+	if (!FParse::Value(*Params, TEXT("Map="), Maps))
+	{
+		UE_LOG(LogVaultLedgeBake, Error, TEXT("Usage: -run=VaultLedgeBake -Map=/Game/Maps/MapA+/Game/Maps/MapB [-Character=/Game/BP_Character.BP_Character_C] [-Spacing=25] [-CellSize=200]"));
+		return 1;
+	}
+
+	FParse::Value(*Params, TEXT("Spacing="), Spacing);
+	FParse::Value(*Params, TEXT("CellSize="), CellSize);
+	if (Spacing <= 0.0f || CellSize <= 0.0f)
+	{
+		UE_LOG(LogVaultLedgeBake, Error, TEXT("Spacing and CellSize have to be positive"));
+		return 1;
+	}
+
+	// Ledges are baked for the settings of a character class, and are only used by characters with the same settings
+	TSubclassOf<AFPSCharacter> CharacterClass = AFPSCharacter::StaticClass();
+	FString CharacterClassPath;
+	if (FParse::Value(*Params, TEXT("Character="), CharacterClassPath))
+	{
+		CharacterClass = LoadClass<AFPSCharacter>(nullptr, *CharacterClassPath);
+		if (!CharacterClass)
+		{
+			UE_LOG(LogVaultLedgeBake, Error, TEXT("%s is not an FPS Character class"), *CharacterClassPath);
+			return 1;
+		}
+	}
+	const FVaultLedgeSettings Settings = CharacterClass->GetDefaultObject<AFPSCharacter>()->GetVaultLedgeSettings();
+
+	TArray<FString> MapPackageNames;
+	Maps.ParseIntoArray(MapPackageNames, TEXT("+"));
+
+	int32 NumFailed = 0;
+	for (const FString &MapPackageName : MapPackageNames)
+	{
+		if (!BakeMap(MapPackageName, Settings))
+		{
+			NumFailed++;
+		}
+	}
+
+	return NumFailed > 0 ? 1 : 0;
+}
+
+bool UVaultLedgeBakeCommandlet::BakeMap(const FString &MapPackageName, const FVaultLedgeSettings &Settings) const
+{
+	UPackage *MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld *World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogVaultLedgeBake, Error, TEXT("Could not load the map %s"), *MapPackageName);
+		return false;
+	}
+
+	// Registering the components of the map with a physics scene, so that it can be traced against
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	const bool bWasInitialized = World->bIsWorldInitialized;
+	if (!bWasInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.RequiresHitProxies(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(true));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	// Searching the area covered by static and stationary geometry, and the space around it from which characters can reach it
+	FBox GeometryBounds(ForceInit);
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		It->ForEachComponent<UPrimitiveComponent>(false, [&GeometryBounds](const UPrimitiveComponent *Component)
+		{
+			if (IsBakedGeometry(Component))
+			{
+				GeometryBounds += Component->Bounds.GetBox();
+			}
+		});
+	}
+	for (const UModelComponent *ModelComponent : World->PersistentLevel->ModelComponents)
+	{
+		if (ModelComponent && IsBakedGeometry(ModelComponent))
+		{
+			GeometryBounds += ModelComponent->Bounds.GetBox();
+		}
+	}
+
+	TArray<FVaultLedge> Ledges;
+	FBox BakedBounds(ForceInit);
+	if (GeometryBounds.IsValid)
+	{
+		constexpr float Reach = FVaultLedgeSettings::WallCheckRadius + FVaultLedgeSettings::WallCheckDistance;
+		BakedBounds = GeometryBounds.ExpandBy(FVector(Reach, Reach, FVaultLedgeSettings::LedgeCheckHeight + Settings.CapsuleHalfHeight));
+		FindLedges(World, GeometryBounds, Settings, Ledges);
+
+		// Characters inside the baked bounds never trace, so any ledge on movable geometry there cannot be vaulted to
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			It->ForEachComponent<UPrimitiveComponent>(false, [&BakedBounds, &MapPackageName](const UPrimitiveComponent *Component)
+			{
+				if (Component->Mobility == EComponentMobility::Movable && BlocksCharacterTraces(Component) && BakedBounds.Intersect(Component->Bounds.GetBox()))
+				{
+					UE_LOG(LogVaultLedgeBake, Warning, TEXT("%s in %s is movable and blocks characters within the baked bounds, so its ledges are not baked and will not be vaulted to"),
+						*Component->GetPathName(), *MapPackageName);
+				}
+			});
+		}
+	}
+
+	if (!bWasInitialized)
+	{
+		World->CleanupWorld();
+	}
+	World->RemoveFromRoot();
+
+	// Saving the ledges next to the map, replacing any that were baked before
+	const FString PackageName = UVaultLedgeData::GetPackageNameForMap(MapPackageName);
+	const FString AssetName = FPackageName::GetShortName(PackageName);
+	UPackage *Package = CreatePackage(*PackageName);
+	Package->FullyLoad();
+
+	UVaultLedgeData *LedgeData = FindObject<UVaultLedgeData>(Package, *AssetName);
+	if (!LedgeData)
+	{
+		LedgeData = NewObject<UVaultLedgeData>(Package, *AssetName, RF_Public | RF_Standalone);
+	}
+	LedgeData->SetLedges(Settings, BakedBounds, Spacing, CellSize, MoveTemp(Ledges));
+	Package->MarkPackageDirty();
+
+	const FString Filename = FPackageName::LongPackageNameToFilename(PackageName, FPackageName::GetAssetPackageExtension());
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	SaveArgs.Error = GError;
+	const bool bSaved = UPackage::SavePackage(Package, LedgeData, *Filename, SaveArgs);
+	if (bSaved)
+	{
+		UE_LOG(LogVaultLedgeBake, Display, TEXT("Baked %d vault ledges for %s into %s"), LedgeData->GetNumLedges(), *MapPackageName, *PackageName);
+	}
+	else
+	{
+		UE_LOG(LogVaultLedgeBake, Error, TEXT("Could not save %s"), *Filename);
+	}
+
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	return bSaved;
+}
+
+TArray<float> UVaultLedgeBakeCommandlet::TraceColumn(const UWorld *World, const float X, const float Y, const FBox &Bounds, const FVaultLedgeSettings &Settings) const
+{
+	const FCollisionQueryParams QueryParams = GetBakeQueryParams();
+	const FVector End(X, Y, Bounds.Min.Z - 1.0f);
+	FVector Start(X, Y, Bounds.Max.Z + 1.0f);
+
+	// Tracing down through every surface of the column. Complex collision is single sided, so a trace starting just below a
+	// surface passes through the geometry underneath it to the next surface down
+	TArray<float> Heights;
+	FHitResult Hit;
+	for (int32 Trace = 0; Trace < MaxTracesPerColumn && Start.Z > End.Z; Trace++)
+	{
+		if (!World->LineTraceSingleByChannel(Hit, Start, End, ECC_WorldStatic, QueryParams))
+		{
+			break;
+		}
+
+		if (Hit.bStartPenetrating)
+		{
+			Start.Z -= Spacing;
+			continue;
+		}
+
+		if (Hit.ImpactNormal.Z >= Settings.WalkableFloorZ)
+		{
+			Heights.Add(Hit.ImpactPoint.Z);
+		}
+		Start.Z = Hit.ImpactPoint.Z - 1.0f;
+	}
+	return Heights;
+}
+
+void UVaultLedgeBakeCommandlet::FindLedges(const UWorld *World, const FBox &Bounds, const FVaultLedgeSettings &Settings, TArray<FVaultLedge> &OutLedges) const
+{
+	const FCollisionQueryParams QueryParams = GetBakeQueryParams();
+	const FCollisionShape CharacterShape = FCollisionShape::MakeCapsule(Settings.CapsuleRadius, Settings.CapsuleHalfHeight);
+
+	const int32 NumX = FMath::CeilToInt(Bounds.GetSize().X / Spacing) + 1;
+	const int32 NumY = FMath::CeilToInt(Bounds.GetSize().Y / Spacing) + 1;
+
+	// Only three rows of columns are kept at once, the one being searched for edges and its neighbours
+	auto TraceRow = [&](const int32 Row)
+	{
+		TArray<TArray<float>> Columns;
+		if (Row >= 0 && Row < NumY)
+		{
+			Columns.SetNum(NumX);
+			for (int32 Column = 0; Column < NumX; Column++)
+			{
+				Columns[Column] = TraceColumn(World, Bounds.Min.X + Column * Spacing, Bounds.Min.Y + Row * Spacing, Bounds, Settings);
+			}
+		}
+		return Columns;
+	};
+
+	// Whether the column next to another has a surface at around the same height, in which case there is no edge between them
+	auto HasSurfaceNear = [this](const TArray<TArray<float>> &Row, const int32 Column, const float Height)
+	{
+		if (!Row.IsValidIndex(Column))
+		{
+			return false;
+		}
+		return Row[Column].ContainsByPredicate([this, Height](const float Other) { return FMath::IsNearlyEqual(Other, Height, Spacing); });
+	};
+
+	TArray<TArray<float>> PreviousRow;
+	TArray<TArray<float>> CurrentRow = TraceRow(0);
+	TArray<TArray<float>> NextRow;
+
+	for (int32 Row = 0; Row < NumY; Row++)
+	{
+		NextRow = TraceRow(Row + 1);
+
+		for (int32 Column = 0; Column < NumX; Column++)
+		{
+			for (const float Height : CurrentRow[Column])
+			{
+				const FVector Surface(Bounds.Min.X + Column * Spacing, Bounds.Min.Y + Row * Spacing, Height);
+
+				for (const FVector &Direction : ApproachDirections)
+				{
+					// Characters approach an edge from the column behind it, which has to be lower
+					const TArray<TArray<float>> &ApproachRow = Direction.Y > 0.0f ? PreviousRow : Direction.Y < 0.0f ? NextRow : CurrentRow;
+					const int32 ApproachColumn = Column - FMath::RoundToInt(Direction.X);
+					if (HasSurfaceNear(ApproachRow, ApproachColumn, Height))
+					{
+						continue;
+					}
+
+					// A character jumping at the edge, with its top within reach, has to fit behind it
+					FVector CharacterLocation = Surface - Direction * (Spacing + Settings.CapsuleRadius);
+					CharacterLocation.Z -= FVaultLedgeSettings::LedgeCheckHeight * 0.5f;
+					if (World->OverlapBlockingTestByChannel(CharacterLocation, FQuat::Identity, ECC_WorldStatic, CharacterShape, QueryParams))
+					{
+						continue;
+					}
+
+					FVaultLedge Ledge;
+					if (FPSCore::TraceVaultLedge(World, CharacterLocation, Direction, Settings, QueryParams, Ledge))
+					{
+						OutLedges.Add(Ledge);
+					}
+				}
+			}
+		}
+
+		PreviousRow = MoveTemp(CurrentRow);
+		CurrentRow = MoveTemp(NextRow);
+
+		if (Row % 64 == 0)
+		{
+			UE_LOG(LogVaultLedgeBake, Display, TEXT("Searched %d of %d rows, found %d ledges"), Row + 1, NumY, OutLedges.Num());
+		}
+	}
+}
@@ -0,0 +1,50 @@
+// Copyright 2022 Ellie Kelemen. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "VaultLedgeBakeCommandlet.generated.h"
+
+struct FVaultLedge;
+struct FVaultLedgeSettings;
+
+/** Bakes the ledges that characters can vault over or mantle onto in a map into a UVaultLedgeData, saved next to the map
+ *	(see UVaultLedgeData::GetPackageNameForMap) and loaded by UVaultLedgeSubsystem when the map is played.
+ *
+ *	The static and stationary geometry of the map is sampled in columns, every Spacing units, for surfaces that can be
+ *	stood on. Wherever one of these surfaces ends above a drop, the runtime ledge search (FPSCore::TraceVaultLedge) is run
+ *	from a character jumping at it, and the ledge it finds is baked. Only actors loaded with the map are sampled, which for
+ *	partitioned maps means always loaded actors only. Movable geometry is not baked, and a warning is logged for every
+ *	movable component which blocks characters within the baked bounds, as characters there do not trace for ledges.
+ *
+ *	Usage: -run=VaultLedgeBake -Map=/Game/Maps/MapA+/Game/Maps/MapB [-Character=/Game/BP_Character.BP_Character_C]
+ *	[-Spacing=25] [-CellSize=200]
+ */
+UCLASS()
+class FPSCOREEDITOR_API UVaultLedgeBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UVaultLedgeBakeCommandlet();
+
+	/** UCommandlet implementation */
+	virtual int32 Main(const FString &Params) override;
+
+private:
+	/** Bakes the ledges of a map and saves them, returning whether the ledges were saved */
+	bool BakeMap(const FString &MapPackageName, const FVaultLedgeSettings &Settings) const;
+
+	/** Returns the heights of every surface that can be stood on, from top to bottom, in the column at X, Y */
+	TArray<float> TraceColumn(const UWorld *World, float X, float Y, const FBox &Bounds, const FVaultLedgeSettings &Settings) const;
+
+	/** Looks for ledges along every edge of the surfaces of a map within Bounds */
+	void FindLedges(const UWorld *World, const FBox &Bounds, const FVaultLedgeSettings &Settings, TArray<FVaultLedge> &OutLedges) const;
+
+	/** The distance between two sampled columns, and so between two ledges along the same edge */
+	float Spacing = 25.0f;
+
+	/** The size of the cells of the baked spatial hash */
+	float CellSize = 200.0f;
+};